@@ -12,64 +12,24 @@ void ofApp::setup() {
 	ofClear(backgroundColor);
 	canvas.end();
 
+	// Initialize the brush shadow canvas, used to pick the colors under the bristles
+	brush.allocate(ofGetWidth(), ofGetHeight(), backgroundColor);
+
 	// Initialize the application variables
-	alphaValue = 0;
 	nextPathLength = 0;
 }
 
 //--------------------------------------------------------------
 void ofApp::update() {
-	// Get the canvas pixels
-	canvas.readToPixels(canvasPixels);
-	int width = canvasPixels.getWidth();
-	int height = canvasPixels.getHeight();
-
 	// Get the cursor current path length
 	float currentPathLength = cursorPath.getPerimeter();
 
 	// Paint the brush on the canvas, starting from the last painted point
 	canvas.begin();
 
-	while (nextPathLength < currentPathLength) {
-		// Update the brush position
-		const glm::vec2& pathPoint = cursorPath.getPointAtLength(nextPathLength);
-		brush.updatePosition(pathPoint, true);
-
-		// Get the bristle positions
-		const vector<glm::vec2>& bristlePositions = brush.getBristlesPositions();
-
-		// Mix the current bristle colors with the color under the bristles positions
-		for (unsigned int i = 0; i < bristlePositions.size(); ++i) {
-			// Check that the bristle is inside the canvas
-			const glm::vec2& pos = bristlePositions[i];
-			int x = pos.x;
-			int y = pos.y;
-
-			if (x >= 0 && x < width && y >= 0 && y < height) {
-				// Get the color under the bristle
-				const ofColor& color = canvasPixels.getColor(x, y);
-
-				// Check if we are over a pixel that has been painted already
-				if (color != backgroundColor) {
-					// Mix the current bristle color with the painted color
-					currentBristleColors[i].lerp(color, 0.001);
-
-					// Add some of the initial color
-					currentBristleColors[i].lerp(initialBristleColors[i], 0.001);
-				} else {
-					// Add some of the initial color
-					currentBristleColors[i].lerp(initialBristleColors[i], 0.05);
-				}
-			}
-		}
-
-		// Decrease the alpha value in each step
-		alphaValue -= 1;
-
-		// Paint the brush on the canvas
-		if (alphaValue > 0) {
-			brush.paint(currentBristleColors, alphaValue);
-		}
+	while (nextPathLength < currentPathLength && brush.hasPaint()) {
+		// Move the brush to the path point and paint it
+		brush.moveTo(cursorPath.getPointAtLength(nextPathLength));
 
 		// Move to the next path length value
 		nextPathLength += 1;
@@ -117,20 +77,17 @@ void ofApp::mouseDragged(int x, int y, int button) {
 void ofApp::mousePressed(int x, int y, int button) {
 	// Create a new brush
 	glm::vec2 mousePos = glm::vec2(x, y);
-	brush = ofxOilBrush(mousePos, ofRandom(50, 70));
+	brush.startStroke(mousePos, ofRandom(50, 70));
 
 	// Calculate the brush bristles colors
-	initialBristleColors.clear();
+	vector<ofColor> bristleColors;
 	float hueValue = ofRandom(255);
 
 	for (unsigned int i = 0, nBristles = brush.getNBristles(); i < nBristles; ++i) {
-		initialBristleColors.push_back(ofColor::fromHsb(hueValue, 200, 180 + ofRandom(-10, 10)));
+		bristleColors.push_back(ofColor::fromHsb(hueValue, 200, 180 + ofRandom(-10, 10)));
 	}
 
-	currentBristleColors = initialBristleColors;
-
-	// Set the initial alpha value
-	alphaValue = 255;
+	brush.setBristleColors(bristleColors);
 
 	// Start a new cursor path at the mouse position
 	cursorPath.clear();
@@ -21,11 +21,7 @@ public:
 
 	ofColor backgroundColor;
 	ofFbo canvas;
-	ofPixels canvasPixels;
-	ofxOilBrush brush;
-	vector<ofColor> initialBristleColors;
-	vector<ofColor> currentBristleColors;
-	float alphaValue;
+	ofxOilInteractiveBrush brush;
 	ofPolyline cursorPath;
 	glm::vec2 lastAddedPoint;
 	float nextPathLength;
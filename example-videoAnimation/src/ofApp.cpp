@@ -3,6 +3,42 @@
 
 //--------------------------------------------------------------
 void ofApp::setup() {
+	// Start the offline render pipeline if necessary
+	if (offlineRender && offlineUsePipeline) {
+		ofPixels firstFrame;
+		ofLoadImage(firstFrame, ofVAArgsToString(offlineInputPattern.c_str(), 0));
+		unsigned int nextFrame = 0;
+		auto decodeFrame = [this, nextFrame](ofPixels& pixels) mutable {
+			return nextFrame < offlineNFrames
+					&& ofLoadImage(pixels, ofVAArgsToString(offlineInputPattern.c_str(), nextFrame++));
+		};
+		auto writeFrame = [this](unsigned int frame, const ofPixels& pixels) {
+			return ofSaveImage(pixels, ofVAArgsToString(offlineOutputPattern.c_str(), frame));
+		};
+
+		offlinePipeline.reset(new ofxOilVideoPipeline(decodeFrame, writeFrame,
+				firstFrame.getWidth() / sizeReductionFactor, firstFrame.getHeight() / sizeReductionFactor));
+		offlinePipeline->start(1, 0, 0, offlineFramesPerChunk);
+		return;
+	}
+
+	// Start the offline render if necessary
+	if (offlineRender) {
+		auto loadFrame = [this](unsigned int frame, ofPixels& pixels) {
+			if (!ofLoadImage(pixels, ofVAArgsToString(offlineInputPattern.c_str(), frame))) {
+				return false;
+			}
+
+			pixels.resize(pixels.getWidth() / sizeReductionFactor, pixels.getHeight() / sizeReductionFactor);
+			return true;
+		};
+
+		offlineRenderer.reset(new ofxOilVideoRenderer(loadFrame, offlineNFrames, offlineOutputPattern,
+				offlineFramesPerChunk, 0, useCanvasBuffer));
+		offlineRenderer->start();
+		return;
+	}
+
 	// Load and start the video
 	video.load(videoFile);
 	video.play();
@@ -28,6 +64,21 @@ void ofApp::setup() {
 
 //--------------------------------------------------------------
 void ofApp::update() {
+	// Check the offline render progress
+	if (offlineRender) {
+		if (offlineRenderer && offlineRenderer->isFinished()) {
+			offlineRenderer->wait();
+			offlineRenderer.reset();
+		}
+
+		if (offlinePipeline && offlinePipeline->isFinished()) {
+			offlinePipeline->wait();
+			offlinePipeline.reset();
+		}
+
+		return;
+	}
+
 	// Move the video to the next frame
 	video.setFrame(ofGetFrameNum() % video.getTotalNumFrames());
 	video.update();
@@ -36,16 +87,35 @@ void ofApp::update() {
 	img.setFromPixels(video.getPixels());
 	img.resize(imgWidth, imgHeight);
 
-	// Obtain an oil paint of the current image
-	simulator.setImage(img, startWithCleanCanvas);
+	// Obtain an oil paint of the current image, without copying its pixels
+	simulator.setImagePixels(ofxOilPixelView(img.getPixels()), startWithCleanCanvas);
 
-	while (!simulator.isFinished()) {
-		simulator.update(false);
-	}
+	simulator.paintUntil(0, 0, maxSecondsPerFrame);
 }
 
 //--------------------------------------------------------------
 void ofApp::draw() {
+	// Show the offline render progress
+	if (offlineRender) {
+		if (offlineRenderer) {
+			string progress = ofToString(offlineRenderer->getNPaintedFrames()) + "/" + ofToString(offlineNFrames);
+			ofDrawBitmapString("Painted frames: " + progress, 20, 20);
+		} else if (offlinePipeline) {
+			vector<string> stageNames = { "Decode", "Resize", "Paint", "Write" };
+
+			for (unsigned int i = 0; i < stageNames.size(); ++i) {
+				ofxOilVideoPipeline::StageStats stats = offlinePipeline->getStageStats(
+						static_cast<ofxOilVideoPipeline::Stage>(i));
+				ofDrawBitmapString(stageNames[i] + ": " + ofToString(stats.nFrames) + " frames, "
+						+ ofToString(stats.framesPerSecond, 2) + " fps", 20, 20 * (i + 1));
+			}
+		} else {
+			ofDrawBitmapString("Offline render finished", 20, 20);
+		}
+
+		return;
+	}
+
 	// Draw the result on the screen
 	simulator.drawCanvas(0, 0);
 
@@ -28,6 +28,20 @@ public:
 	bool useCanvasBuffer = false;
 	// Paint each picture with a clean canvas
 	bool startWithCleanCanvas = false;
+	// The maximum time to spend painting each video frame in seconds (0 means no limit)
+	float maxSecondsPerFrame = 0;
+	// Paint an image sequence offline using several threads, instead of painting the video on screen
+	bool offlineRender = false;
+	// The offline render input and output image sequences file name patterns
+	string offlineInputPattern = "frames/frame_%05d.png";
+	string offlineOutputPattern = "paintedFrames/frame_%05d.png";
+	// The number of frames to paint in the offline render
+	unsigned int offlineNFrames = 100;
+	// The number of consecutive frames that are painted starting from the previous frame painting
+	unsigned int offlineFramesPerChunk = 10;
+	// Use a decode, resize, paint and write pipeline for the offline render, instead of loading and painting each
+	// frame in the same thread
+	bool offlineUsePipeline = false;
 	// Compare the oil paint simulation with the video picture
 	bool comparisonMode = true;
 
@@ -37,4 +51,6 @@ public:
 	int imgWidth;
 	int imgHeight;
 	ofxOilSimulator simulator;
+	unique_ptr<ofxOilVideoRenderer> offlineRenderer;
+	unique_ptr<ofxOilVideoPipeline> offlinePipeline;
 };
@@ -3,10 +3,15 @@
 
 //--------------------------------------------------------------
 void ofApp::setup() {
-	// Start the webcam
-	webcam.setDeviceID(0);
-	webcam.setDesiredFrameRate(webcamFrameRate);
-	webcam.setup(webcamWidth, webcamHeight);
+	// Start capturing the synthetic frames in a background thread, or set up the webcam
+	if (useSyntheticFrames) {
+		liveSource.start(ofxOilLiveSource::createSyntheticSource(webcamWidth, webcamHeight, webcamFrameRate));
+	} else {
+		webcam.setDeviceID(0);
+		webcam.setDesiredFrameRate(webcamFrameRate);
+		webcam.setUseTexture(false);
+		webcam.setup(webcamWidth, webcamHeight);
+	}
 
 	// Resize the application window
 	if (comparisonMode) {
@@ -21,15 +26,20 @@ void ofApp::setup() {
 
 //--------------------------------------------------------------
 void ofApp::update() {
-	// Update the webcam
-	webcam.update();
-
-	// Obtain an oil paint of the current webcam image
-	simulator.setImagePixels(webcam.getPixels(), startWithCleanCanvas);
+	// The grabber is not thread safe, so it's updated here and its new frames are published directly
+	if (!useSyntheticFrames) {
+		webcam.update();
 
-	while (!simulator.isFinished()) {
-		simulator.update(false);
+		if (webcam.isFrameNew()) {
+			liveSource.publishFrame(webcam.getPixels());
+		}
 	}
+
+	// Start painting the latest webcam frame if there is a new one
+	liveSource.update(simulator, startWithCleanCanvas);
+
+	// Paint the current frame for a limited time, to keep the latency bounded
+	simulator.paintUntil(0, 0, maxSecondsPerFrame);
 }
 
 //--------------------------------------------------------------
@@ -25,6 +25,10 @@ public:
 	int webcamHeight = 240;
 	// The webcam frame rate to use
 	int webcamFrameRate = 30;
+	// The maximum time to spend painting each webcam frame in seconds
+	float maxSecondsPerFrame = 0.2;
+	// Use synthetic frames instead of the webcam frames
+	bool useSyntheticFrames = false;
 	// Paint each picture with a clean canvas
 	bool startWithCleanCanvas = false;
 	// Compare the oil paint simulation with the webcam picture
@@ -32,5 +36,6 @@ public:
 
 	// Application variables
 	ofVideoGrabber webcam;
+	ofxOilLiveSource liveSource;
 	ofxOilSimulator simulator;
 };
@@ -0,0 +1,94 @@
+#include "ofxOilBitMask.h"
+#include "ofxOilSerialization.h"
+#include "ofMain.h"
+
+ofxOilBitMask::ofxOilBitMask(unsigned int _width, unsigned int _height) {
+	allocate(_width, _height);
+}
+
+void ofxOilBitMask::allocate(unsigned int _width, unsigned int _height) {
+	width = _width;
+	height = _height;
+	wordsPerRow = (width + 63) / 64;
+
+	// A row epoch equal to zero indicates that the row has never been written
+	epoch = 1;
+	rowEpochs = vector<uint32_t>(height, 0);
+	bits = vector<uint64_t>(wordsPerRow * height, 0);
+}
+
+void ofxOilBitMask::clear() {
+	++epoch;
+
+	// Reset the row epochs in the unlikely case that the epoch counter wraps around
+	if (epoch == 0) {
+		fill(rowEpochs.begin(), rowEpochs.end(), 0);
+		epoch = 1;
+	}
+}
+
+void ofxOilBitMask::toPixels(ofPixels& pixels, unsigned char setValue, unsigned char unsetValue) const {
+	pixels.allocate(width, height, OF_PIXELS_GRAY);
+
+	for (unsigned int y = 0; y < height; ++y) {
+		for (unsigned int x = 0; x < width; ++x) {
+			pixels[y * width + x] = test(x, y) ? setValue : unsetValue;
+		}
+	}
+}
+
+unsigned int ofxOilBitMask::getWidth() const {
+	return width;
+}
+
+unsigned int ofxOilBitMask::getHeight() const {
+	return height;
+}
+
+void ofxOilBitMask::save(ostream& out) const {
+	ofxOilWrite(out, uint32_t(width));
+	ofxOilWrite(out, uint32_t(height));
+
+	// Save only the rows that have been written in the current epoch
+	vector<uint32_t> currentRows;
+
+	for (unsigned int y = 0; y < height; ++y) {
+		if (rowEpochs[y] == epoch) {
+			currentRows.push_back(y);
+		}
+	}
+
+	ofxOilWrite(out, currentRows);
+
+	for (uint32_t y : currentRows) {
+		out.write(reinterpret_cast<const char*>(&bits[y * wordsPerRow]), wordsPerRow * sizeof(uint64_t));
+	}
+}
+
+void ofxOilBitMask::load(istream& in) {
+	uint32_t newWidth = 0;
+	uint32_t newHeight = 0;
+	vector<uint32_t> currentRows;
+	ofxOilRead(in, newWidth);
+	ofxOilRead(in, newHeight);
+	ofxOilRead(in, currentRows);
+
+	// Each row needs the bytes of its words
+	uint64_t rowBytes = ((uint64_t(newWidth) + 63) / 64) * sizeof(uint64_t);
+
+	if (!in || currentRows.size() > newHeight
+			|| (rowBytes > 0 && currentRows.size() > ofxOilGetRemainingBytes(in) / rowBytes)) {
+		throw runtime_error("Unexpected end of stream while reading the mask.");
+	}
+
+	allocate(newWidth, newHeight);
+
+	for (uint32_t y : currentRows) {
+		if (y >= height) {
+			throw runtime_error("Invalid row index while reading the mask.");
+		}
+
+		in.read(reinterpret_cast<char*>(&bits[y * wordsPerRow]), wordsPerRow * sizeof(uint64_t));
+		rowEpochs[y] = epoch;
+	}
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "ofMain.h"
+
+/**
+ * @brief Class that stores one bit per pixel and that can be reset in constant time
+ *
+ * The bits are packed in 64 bit words. Each row keeps track of the mask epoch when it was last written, so a reset
+ * only needs to increment the current epoch. Rows with an old epoch are considered empty and are cleared lazily the
+ * next time that one of their bits is set.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilBitMask {
+public:
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param _width the mask width
+	 * @param _height the mask height
+	 */
+	ofxOilBitMask(unsigned int _width = 0, unsigned int _height = 0);
+
+	/**
+	 * @brief Allocates the mask and sets all its bits to false
+	 *
+	 * @param _width the mask width
+	 * @param _height the mask height
+	 */
+	void allocate(unsigned int _width, unsigned int _height);
+
+	/**
+	 * @brief Sets all the mask bits to false
+	 */
+	void clear();
+
+	/**
+	 * @brief Sets to true the mask bit at the given position
+	 *
+	 * Note that the position is not checked to be inside the mask.
+	 *
+	 * @param x the mask x position
+	 * @param y the mask y position
+	 */
+	void set(unsigned int x, unsigned int y);
+
+	/**
+	 * @brief Sets to false the mask bit at the given position
+	 *
+	 * Note that the position is not checked to be inside the mask.
+	 *
+	 * @param x the mask x position
+	 * @param y the mask y position
+	 */
+	void reset(unsigned int x, unsigned int y);
+
+	/**
+	 * @brief Returns the mask bit at the given position
+	 *
+	 * Note that the position is not checked to be inside the mask.
+	 *
+	 * @param x the mask x position
+	 * @param y the mask y position
+	 * @return true if the bit has been set since the last clear
+	 */
+	bool test(unsigned int x, unsigned int y) const;
+
+	/**
+	 * @brief Fills a gray pixels container with the mask values
+	 *
+	 * @param pixels the pixels container to fill
+	 * @param setValue the pixel value to use for the bits that are set
+	 * @param unsetValue the pixel value to use for the bits that are not set
+	 */
+	void toPixels(ofPixels& pixels, unsigned char setValue, unsigned char unsetValue) const;
+
+	/**
+	 * @brief Returns the mask width
+	 *
+	 * @return the mask width
+	 */
+	unsigned int getWidth() const;
+
+	/**
+	 * @brief Returns the mask height
+	 *
+	 * @return the mask height
+	 */
+	unsigned int getHeight() const;
+
+	/**
+	 * @brief Saves the mask state in a binary stream
+	 *
+	 * @param out the output stream
+	 */
+	void save(ostream& out) const;
+
+	/**
+	 * @brief Loads the mask state from a binary stream
+	 *
+	 * @param in the input stream
+	 */
+	void load(istream& in);
+
+protected:
+
+	/**
+	 * @brief The mask width
+	 */
+	unsigned int width;
+
+	/**
+	 * @brief The mask height
+	 */
+	unsigned int height;
+
+	/**
+	 * @brief The number of 64 bit words used to store each mask row
+	 */
+	unsigned int wordsPerRow;
+
+	/**
+	 * @brief The current mask epoch
+	 */
+	uint32_t epoch;
+
+	/**
+	 * @brief The epoch when each mask row was last written
+	 */
+	vector<uint32_t> rowEpochs;
+
+	/**
+	 * @brief The packed mask bits
+	 */
+	vector<uint64_t> bits;
+};
+
+inline void ofxOilBitMask::set(unsigned int x, unsigned int y) {
+	uint64_t* row = &bits[y * wordsPerRow];
+
+	// Clear the row first if it was written in a previous epoch
+	if (rowEpochs[y] != epoch) {
+		fill(row, row + wordsPerRow, 0);
+		rowEpochs[y] = epoch;
+	}
+
+	row[x >> 6] |= uint64_t(1) << (x & 63);
+}
+
+inline void ofxOilBitMask::reset(unsigned int x, unsigned int y) {
+	// Rows written in a previous epoch are already empty
+	if (rowEpochs[y] == epoch) {
+		bits[y * wordsPerRow + (x >> 6)] &= ~(uint64_t(1) << (x & 63));
+	}
+}
+
+inline bool ofxOilBitMask::test(unsigned int x, unsigned int y) const {
+	return rowEpochs[y] == epoch && ((bits[y * wordsPerRow + (x >> 6)] >> (x & 63)) & 1) != 0;
+}
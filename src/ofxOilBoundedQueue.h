@@ -0,0 +1,148 @@
+#pragma once
+
+#include "ofMain.h"
+#include <condition_variable>
+#include <deque>
+
+/**
+ * @brief Thread safe first in first out queue with a maximum size
+ *
+ * Pushing to a full queue blocks until another thread pops an element, so a slow consumer slows down the producers
+ * instead of letting the queue grow. Once the queue is closed, pushes are ignored and pops return the remaining
+ * elements before failing.
+ *
+ * @author Javier Graciá Carpio
+ */
+template<typename T>
+class ofxOilBoundedQueue {
+public:
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param _capacity the maximum number of elements in the queue
+	 */
+	ofxOilBoundedQueue(size_t _capacity = 4) :
+			capacity(max(_capacity, size_t(1))), closed(false) {
+	}
+
+	/**
+	 * @brief Adds an element at the end of the queue, waiting if the queue is full
+	 *
+	 * @param element the element to add
+	 * @return false if the queue was closed and the element was not added
+	 */
+	bool push(T&& element) {
+		unique_lock<mutex> lock(queueMutex);
+		notFull.wait(lock, [this]() {return closed || elements.size() < capacity;});
+
+		if (closed) {
+			return false;
+		}
+
+		elements.push_back(move(element));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	/**
+	 * @brief Removes the first element of the queue, waiting if the queue is empty
+	 *
+	 * @param element the removed element
+	 * @return false if the queue is closed and empty
+	 */
+	bool pop(T& element) {
+		unique_lock<mutex> lock(queueMutex);
+		notEmpty.wait(lock, [this]() {return closed || !elements.empty();});
+
+		if (elements.empty()) {
+			return false;
+		}
+
+		element = move(elements.front());
+		elements.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	/**
+	 * @brief Closes the queue and wakes up all the waiting threads
+	 */
+	void close() {
+		lock_guard<mutex> lock(queueMutex);
+		closed = true;
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+
+	/**
+	 * @brief Removes all the elements and opens the queue again
+	 */
+	void reset() {
+		lock_guard<mutex> lock(queueMutex);
+		elements.clear();
+		closed = false;
+	}
+
+	/**
+	 * @brief Sets the maximum number of elements in the queue
+	 *
+	 * @param _capacity the maximum number of elements in the queue
+	 */
+	void setCapacity(size_t _capacity) {
+		lock_guard<mutex> lock(queueMutex);
+		capacity = max(_capacity, size_t(1));
+		notFull.notify_all();
+	}
+
+	/**
+	 * @brief Returns the current number of elements in the queue
+	 *
+	 * @return the number of elements in the queue
+	 */
+	size_t size() const {
+		lock_guard<mutex> lock(queueMutex);
+		return elements.size();
+	}
+
+	/**
+	 * @brief Returns the maximum number of elements in the queue
+	 *
+	 * @return the queue capacity
+	 */
+	size_t getCapacity() const {
+		return capacity;
+	}
+
+protected:
+
+	/**
+	 * @brief The maximum number of elements in the queue
+	 */
+	size_t capacity;
+
+	/**
+	 * @brief The queue elements
+	 */
+	deque<T> elements;
+
+	/**
+	 * @brief Indicates if the queue is closed
+	 */
+	bool closed;
+
+	/**
+	 * @brief The mutex that protects the queue
+	 */
+	mutable mutex queueMutex;
+
+	/**
+	 * @brief Condition used to wait until the queue is not empty
+	 */
+	condition_variable notEmpty;
+
+	/**
+	 * @brief Condition used to wait until the queue is not full
+	 */
+	condition_variable notFull;
+};
@@ -1,4 +1,5 @@
 #include "ofxOilBristle.h"
+#include "ofxOilSerialization.h"
 #include "ofMain.h"
 
 ofxOilBristle::ofxOilBristle(const glm::vec2& position, float length) {
@@ -60,6 +61,128 @@ void ofxOilBristle::paint(const ofColor& color, float thickness) const {
 	}
 }
 
+void ofxOilBristle::paint(ofPixels& pixels, const ofColor& color, float thickness) const {
+	// Paint the bristle elements
+	unsigned int nElements = getNElements();
+	float deltaThickness = thickness / nElements;
+
+	for (unsigned int i = 0; i < nElements; ++i) {
+		// Use the cached stamp if the segment is not too large
+		const glm::vec2& start = positions[i];
+		const glm::vec2& end = positions[i + 1];
+		float startThickness = thickness - i * deltaThickness;
+		const ofxOilStampCache::Stamp* stamp = ofxOilStampCache::getStamp(start, end, startThickness,
+				startThickness - deltaThickness);
+
+		if (stamp != nullptr) {
+			paintStamp(pixels, *stamp, start, color);
+		} else {
+			paintSegment(pixels, start, end, startThickness, color);
+		}
+	}
+}
+
+void ofxOilBristle::paintSegment(ofPixels& pixels, const glm::vec2& start, const glm::vec2& end, float thickness,
+		const ofColor& color) {
+	// Calculate the segment bounding box, clipped to the pixels container
+	int width = pixels.getWidth();
+	int height = pixels.getHeight();
+	float radius = max(0.5f * thickness, 0.5f);
+	int xMin = max(0, int(floor(min(start.x, end.x) - radius)));
+	int xMax = min(width - 1, int(ceil(max(start.x, end.x) + radius)));
+	int yMin = max(0, int(floor(min(start.y, end.y) - radius)));
+	int yMax = min(height - 1, int(ceil(max(start.y, end.y) + radius)));
+
+	if (xMin > xMax || yMin > yMax || color.a == 0) {
+		return;
+	}
+
+	// Segments thinner than one pixel only cover part of the pixels
+	float alpha = color.a * min(thickness, 1.0f);
+	unsigned int nChannels = pixels.getNumChannels();
+	unsigned char* data = pixels.getData();
+	glm::vec2 direction = end - start;
+	float lengthSq = direction.x * direction.x + direction.y * direction.y;
+
+	for (int y = yMin; y <= yMax; ++y) {
+		for (int x = xMin; x <= xMax; ++x) {
+			// Calculate the distance between the pixel center and the segment
+			float px = x + 0.5f - start.x;
+			float py = y + 0.5f - start.y;
+			float t = lengthSq > 0 ? ofClamp((px * direction.x + py * direction.y) / lengthSq, 0, 1) : 0;
+			float dx = px - t * direction.x;
+			float dy = py - t * direction.y;
+			float coverage = ofClamp(radius + 0.5f - sqrt(dx * dx + dy * dy), 0, 1);
+
+			// Blend the segment color with the pixel color
+			int weight = alpha * coverage;
+
+			if (weight > 0) {
+				unsigned char* pixel = data + (y * width + x) * nChannels;
+
+				if (nChannels >= 3) {
+					pixel[0] += ((color.r - pixel[0]) * weight) / 255;
+					pixel[1] += ((color.g - pixel[1]) * weight) / 255;
+					pixel[2] += ((color.b - pixel[2]) * weight) / 255;
+				} else {
+					pixel[0] += ((int(color.getBrightness()) - pixel[0]) * weight) / 255;
+				}
+			}
+		}
+	}
+}
+
+void ofxOilBristle::paintStamp(ofPixels& pixels, const ofxOilStampCache::Stamp& stamp, const glm::vec2& start,
+		const ofColor& color) {
+	// Calculate the stamp position, clipped to the pixels container
+	int width = pixels.getWidth();
+	int height = pixels.getHeight();
+	int x0 = int(floor(start.x)) + stamp.x;
+	int y0 = int(floor(start.y)) + stamp.y;
+	int xMin = max(0, x0);
+	int xMax = min(width - 1, x0 + stamp.width - 1);
+	int yMin = max(0, y0);
+	int yMax = min(height - 1, y0 + stamp.height - 1);
+
+	if (xMin > xMax || yMin > yMax || color.a == 0) {
+		return;
+	}
+
+	// Blend the segment color with the pixels color
+	unsigned int nChannels = pixels.getNumChannels();
+	unsigned char* data = pixels.getData();
+	int brightness = color.getBrightness();
+
+	for (int y = yMin; y <= yMax; ++y) {
+		const unsigned char* coverage = stamp.coverage.data() + (y - y0) * stamp.width + (xMin - x0);
+		unsigned char* pixel = data + (y * width + xMin) * nChannels;
+
+		for (int x = xMin; x <= xMax; ++x, pixel += nChannels) {
+			int weight = (color.a * coverage[x - xMin]) / 255;
+
+			if (weight > 0) {
+				if (nChannels >= 3) {
+					pixel[0] += ((color.r - pixel[0]) * weight) / 255;
+					pixel[1] += ((color.g - pixel[1]) * weight) / 255;
+					pixel[2] += ((color.b - pixel[2]) * weight) / 255;
+				} else {
+					pixel[0] += ((brightness - pixel[0]) * weight) / 255;
+				}
+			}
+		}
+	}
+}
+
 unsigned int ofxOilBristle::getNElements() const {
 	return lengths.size();
 }
+
+void ofxOilBristle::save(ostream& out) const {
+	ofxOilWrite(out, positions);
+	ofxOilWrite(out, lengths);
+}
+
+void ofxOilBristle::load(istream& in) {
+	ofxOilRead(in, positions);
+	ofxOilRead(in, lengths);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ofMain.h"
+#include "ofxOilStampCache.h"
 
 /**
  * @brief Class that simulates the movement of a bristle
@@ -47,6 +48,18 @@ public:
 	 */
 	void paint(const ofColor& color, float thickness) const;
 
+	/**
+	 * @brief Paints the bristle on a pixels container
+	 *
+	 * The bristle elements are painted on the CPU as anti-aliased tapered segments with round ends, blended with the
+	 * pixels using the color alpha value. The segments are taken from the ofxOilStampCache when possible.
+	 *
+	 * @param pixels the pixels container where the bristle should be painted
+	 * @param color the color to use
+	 * @param thickness the thickness of the first bristle element
+	 */
+	void paint(ofPixels& pixels, const ofColor& color, float thickness) const;
+
 	/**
 	 * @brief Returns the number of bristle elements
 	 *
@@ -54,8 +67,45 @@ public:
 	 */
 	unsigned int getNElements() const;
 
+	/**
+	 * @brief Saves the bristle state in a binary stream
+	 *
+	 * @param out the output stream
+	 */
+	void save(ostream& out) const;
+
+	/**
+	 * @brief Loads the bristle state from a binary stream
+	 *
+	 * @param in the input stream
+	 */
+	void load(istream& in);
+
 protected:
 
+	/**
+	 * @brief Paints an anti-aliased segment on a pixels container
+	 *
+	 * @param pixels the pixels container where the segment should be painted
+	 * @param start the segment start position
+	 * @param end the segment end position
+	 * @param thickness the segment thickness
+	 * @param color the segment color
+	 */
+	static void paintSegment(ofPixels& pixels, const glm::vec2& start, const glm::vec2& end, float thickness,
+			const ofColor& color);
+
+	/**
+	 * @brief Paints a pre-rasterized segment on a pixels container
+	 *
+	 * @param pixels the pixels container where the segment should be painted
+	 * @param stamp the segment stamp
+	 * @param start the segment start position
+	 * @param color the segment color
+	 */
+	static void paintStamp(ofPixels& pixels, const ofxOilStampCache::Stamp& stamp, const glm::vec2& start,
+			const ofColor& color);
+
 	/**
 	 * @brief The bristle elements positions
 	 */
@@ -1,5 +1,7 @@
 #include "ofxOilBrush.h"
 #include "ofxOilBristle.h"
+#include "ofxOilRandom.h"
+#include "ofxOilSerialization.h"
 #include "ofMain.h"
 
 float ofxOilBrush::MAX_BRISTLE_LENGTH = 15;
@@ -20,17 +22,17 @@ ofxOilBrush::ofxOilBrush(const glm::vec2& _position, float _size) :
 	bristlesLength = min(size, MAX_BRISTLE_LENGTH);
 	bristlesThickness = min(0.8f * bristlesLength, MAX_BRISTLE_THICKNESS);
 	bristlesHorizontalNoise = min(0.3f * size, MAX_BRISTLE_HORIZONTAL_NOISE);
-	bristlesHorizontalNoiseSeed = ofRandom(1000);
+	bristlesHorizontalNoiseSeed = ofxOilRandom(1000);
 
 	// Initialize the bristles offsets and positions containers with default values
-	unsigned int nBristles = floor(size * ofRandom(1.6, 1.9));
+	unsigned int nBristles = floor(size * ofxOilRandom(1.6, 1.9));
 	bOffsets = vector<glm::vec2>(nBristles);
 	bPositions = vector<glm::vec2>(nBristles);
 
 	// Randomize the bristle offset positions
 	for (glm::vec2& offset : bOffsets) {
-		offset.x = size * ofRandom(-0.5, 0.5);
-		offset.y = BRISTLE_VERTICAL_NOISE * ofRandom(-0.5, 0.5);
+		offset.x = size * ofxOilRandom(-0.5, 0.5);
+		offset.y = BRISTLE_VERTICAL_NOISE * ofxOilRandom(-0.5, 0.5);
 	}
 
 	// Initialize the variables used to calculate the brush average position
@@ -132,7 +134,7 @@ void ofxOilBrush::paint(const ofColor& color) const {
 	}
 }
 
-void ofxOilBrush::paint(const vector<ofColor>& colors, unsigned char alpha) const {
+void ofxOilBrush::paint(ofxOilSpan<const ofColor> colors, unsigned char alpha) const {
 	// Check that the input makes sense
 	if (colors.size() != getNBristles()) {
 		throw invalid_argument("There should be one color for each bristle in the brush.");
@@ -149,10 +151,80 @@ void ofxOilBrush::paint(const vector<ofColor>& colors, unsigned char alpha) cons
 	}
 }
 
+void ofxOilBrush::paint(ofPixels& pixels, ofxOilSpan<const ofColor> colors, unsigned char alpha) const {
+	// Check that the input makes sense
+	if (colors.size() != getNBristles()) {
+		throw invalid_argument("There should be one color for each bristle in the brush.");
+	}
+
+	if (positionsHistory.size() == POSITIONS_FOR_AVERAGE) {
+		for (unsigned int i = 0, nBristles = getNBristles(); i < nBristles; ++i) {
+			bristles[i].paint(pixels, ofColor(colors[i], alpha), bristlesThickness);
+		}
+	}
+}
+
 unsigned int ofxOilBrush::getNBristles() const {
 	return bOffsets.size();
 }
 
-const vector<glm::vec2> ofxOilBrush::getBristlesPositions() const {
-	return positionsHistory.size() == POSITIONS_FOR_AVERAGE ? bPositions : vector<glm::vec2>();
+ofxOilSpan<const glm::vec2> ofxOilBrush::getBristlesPositions() const {
+	return positionsHistory.size() == POSITIONS_FOR_AVERAGE ? ofxOilSpan<const glm::vec2>(bPositions) :
+			ofxOilSpan<const glm::vec2>();
+}
+
+float ofxOilBrush::getBristlesLength() const {
+	return bristlesLength;
+}
+
+float ofxOilBrush::getBristlesThickness() const {
+	return bristlesThickness;
+}
+
+void ofxOilBrush::save(ostream& out) const {
+	ofxOilWrite(out, position);
+	ofxOilWrite(out, size);
+	ofxOilWrite(out, bristlesLength);
+	ofxOilWrite(out, bristlesThickness);
+	ofxOilWrite(out, bristlesHorizontalNoise);
+	ofxOilWrite(out, bristlesHorizontalNoiseSeed);
+	ofxOilWrite(out, bOffsets);
+	ofxOilWrite(out, bPositions);
+	ofxOilWrite(out, uint64_t(bristles.size()));
+
+	for (const ofxOilBristle& bristle : bristles) {
+		bristle.save(out);
+	}
+
+	ofxOilWrite(out, averagePosition);
+	ofxOilWrite(out, positionsHistory);
+	ofxOilWrite(out, updatesCounter);
+}
+
+void ofxOilBrush::load(istream& in) {
+	ofxOilRead(in, position);
+	ofxOilRead(in, size);
+	ofxOilRead(in, bristlesLength);
+	ofxOilRead(in, bristlesThickness);
+	ofxOilRead(in, bristlesHorizontalNoise);
+	ofxOilRead(in, bristlesHorizontalNoiseSeed);
+	ofxOilRead(in, bOffsets);
+	ofxOilRead(in, bPositions);
+	uint64_t nBristles = 0;
+	ofxOilRead(in, nBristles);
+
+	// Each bristle needs at least the bytes of its two vector sizes
+	if (!in || nBristles > ofxOilGetRemainingBytes(in) / (2 * sizeof(uint64_t))) {
+		throw runtime_error("Unexpected end of stream while reading the brush.");
+	}
+
+	bristles = vector<ofxOilBristle>(nBristles);
+
+	for (ofxOilBristle& bristle : bristles) {
+		bristle.load(in);
+	}
+
+	ofxOilRead(in, averagePosition);
+	ofxOilRead(in, positionsHistory);
+	ofxOilRead(in, updatesCounter);
 }
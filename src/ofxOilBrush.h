@@ -2,6 +2,7 @@
 
 #include "ofMain.h"
 #include "ofxOilBristle.h"
+#include "ofxOilSpan.h"
 
 /**
  * @brief Class that simulates a brush composed of several bristles
@@ -77,7 +78,16 @@ public:
 	 * @param colors the bristles colors
 	 * @param alpha the colors alpha value
 	 */
-	void paint(const vector<ofColor>& colors, unsigned char alpha) const;
+	void paint(ofxOilSpan<const ofColor> colors, unsigned char alpha) const;
+
+	/**
+	 * @brief Paints the brush on a pixels container using the provided bristles colors
+	 *
+	 * @param pixels the pixels container where the brush should be painted
+	 * @param colors the bristles colors
+	 * @param alpha the colors alpha value
+	 */
+	void paint(ofPixels& pixels, ofxOilSpan<const ofColor> colors, unsigned char alpha) const;
 
 	/**
 	 * @brief Returns the total number of bristles in the brush
@@ -89,9 +99,40 @@ public:
 	/**
 	 * @brief Returns the current bristles positions
 	 *
-	 * @return a vector with the current bristles positions
+	 * The span remains valid until the brush is moved.
+	 *
+	 * @return a span with the current bristles positions. It will be empty if the brush didn't move enough to
+	 * calculate them.
+	 */
+	ofxOilSpan<const glm::vec2> getBristlesPositions() const;
+
+	/**
+	 * @brief Returns the bristles length
+	 *
+	 * @return the bristles length
+	 */
+	float getBristlesLength() const;
+
+	/**
+	 * @brief Returns the thickness of the first element of the bristles
+	 *
+	 * @return the bristles thickness
+	 */
+	float getBristlesThickness() const;
+
+	/**
+	 * @brief Saves the brush state in a binary stream
+	 *
+	 * @param out the output stream
+	 */
+	void save(ostream& out) const;
+
+	/**
+	 * @brief Loads the brush state from a binary stream
+	 *
+	 * @param in the input stream
 	 */
-	const vector<glm::vec2> getBristlesPositions() const;
+	void load(istream& in);
 
 protected:
 
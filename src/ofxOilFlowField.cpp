@@ -0,0 +1,147 @@
+#include "ofxOilFlowField.h"
+#include "ofxOilPixelView.h"
+#include "ofMain.h"
+
+unsigned int ofxOilFlowField::TENSOR_SMOOTHING_RADIUS = 4;
+
+ofxOilFlowField::ofxOilFlowField() :
+		width(0), height(0) {
+}
+
+void ofxOilFlowField::update(const ofxOilPixelView& img) {
+	width = img.getWidth();
+	height = img.getHeight();
+	unsigned int nPixels = width * height;
+
+	// Calculate the image luminance
+	vector<float> luminance(nPixels);
+
+	for (unsigned int y = 0, pixel = 0; y < height; ++y) {
+		for (unsigned int x = 0; x < width; ++x, ++pixel) {
+			ofColor color = img.getColor(x, y);
+			luminance[pixel] = 0.299f * color.r + 0.587f * color.g + 0.114f * color.b;
+		}
+	}
+
+	// Calculate the structure tensor components with the Sobel operator
+	vector<float> jxx(nPixels);
+	vector<float> jxy(nPixels);
+	vector<float> jyy(nPixels);
+
+	for (unsigned int y = 0, pixel = 0; y < height; ++y) {
+		unsigned int yUp = y > 0 ? y - 1 : 0;
+		unsigned int yDown = y + 1 < height ? y + 1 : y;
+		const float* rowUp = &luminance[yUp * width];
+		const float* row = &luminance[y * width];
+		const float* rowDown = &luminance[yDown * width];
+
+		for (unsigned int x = 0; x < width; ++x, ++pixel) {
+			unsigned int xLeft = x > 0 ? x - 1 : 0;
+			unsigned int xRight = x + 1 < width ? x + 1 : x;
+			float gx = (rowUp[xRight] + 2 * row[xRight] + rowDown[xRight])
+					- (rowUp[xLeft] + 2 * row[xLeft] + rowDown[xLeft]);
+			float gy = (rowDown[xLeft] + 2 * rowDown[x] + rowDown[xRight])
+					- (rowUp[xLeft] + 2 * rowUp[x] + rowUp[xRight]);
+			jxx[pixel] = gx * gx;
+			jxy[pixel] = gx * gy;
+			jyy[pixel] = gy * gy;
+		}
+	}
+
+	// Smooth the tensor components
+	boxFilter(jxx, luminance);
+	boxFilter(jxy, luminance);
+	boxFilter(jyy, luminance);
+
+	// The flow follows the eigenvector with the smallest eigenvalue and its length is the tensor coherence
+	flow.resize(nPixels);
+
+	for (unsigned int pixel = 0; pixel < nPixels; ++pixel) {
+		float diff = jxx[pixel] - jyy[pixel];
+		float sum = jxx[pixel] + jyy[pixel];
+		float root = sqrt(diff * diff + 4 * jxy[pixel] * jxy[pixel]);
+
+		if (sum <= 0 || root <= 0) {
+			flow[pixel] = glm::vec2();
+		} else {
+			float coherence = pow(root / sum, 2);
+			float ang = 0.5 * atan2(2 * jxy[pixel], diff) + HALF_PI;
+			flow[pixel] = coherence * glm::vec2(cos(ang), sin(ang));
+		}
+	}
+}
+
+void ofxOilFlowField::clear() {
+	width = 0;
+	height = 0;
+	flow.clear();
+}
+
+glm::vec2 ofxOilFlowField::getFlow(const glm::vec2& pos) const {
+	int x = pos.x;
+	int y = pos.y;
+
+	if (x >= 0 && x < int(width) && y >= 0 && y < int(height)) {
+		return flow[y * width + x];
+	} else {
+		return glm::vec2();
+	}
+}
+
+bool ofxOilFlowField::isAllocated() const {
+	return flow.size() > 0;
+}
+
+unsigned int ofxOilFlowField::getWidth() const {
+	return width;
+}
+
+unsigned int ofxOilFlowField::getHeight() const {
+	return height;
+}
+
+void ofxOilFlowField::boxFilter(vector<float>& values, vector<float>& buffer) const {
+	// Filter the rows and save the result in the buffer using a running sum
+	int radius = TENSOR_SMOOTHING_RADIUS;
+	int w = width;
+	int h = height;
+
+	for (int y = 0; y < h; ++y) {
+		const float* row = &values[y * w];
+		float* bufferRow = &buffer[y * w];
+		float sum = 0;
+
+		for (int x = -radius; x < w; ++x) {
+			if (x + radius < w) {
+				sum += row[x + radius];
+			}
+
+			if (x - radius - 1 >= 0) {
+				sum -= row[x - radius - 1];
+			}
+
+			if (x >= 0) {
+				bufferRow[x] = sum;
+			}
+		}
+	}
+
+	// Filter the buffer columns and save the result in the values array
+	for (int x = 0; x < w; ++x) {
+		float sum = 0;
+
+		for (int y = -radius; y < h; ++y) {
+			if (y + radius < h) {
+				sum += buffer[(y + radius) * w + x];
+			}
+
+			if (y - radius - 1 >= 0) {
+				sum -= buffer[(y - radius - 1) * w + x];
+			}
+
+			if (y >= 0) {
+				values[y * w + x] = sum;
+			}
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOilPixelView.h"
+
+/**
+ * @brief Class that calculates the edge tangent flow of an image
+ *
+ * The flow is obtained from the smoothed structure tensor of the image luminance. At each pixel it points along the
+ * direction of minimum color change, with a length equal to the local coherence: close to one near well defined edges
+ * and close to zero in flat or noisy regions. The flow direction has no sign, so v and -v are equivalent.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilFlowField {
+public:
+
+	/**
+	 * @brief The radius in pixels of the box filter used to smooth the structure tensor
+	 */
+	static unsigned int TENSOR_SMOOTHING_RADIUS;
+
+	/**
+	 * @brief Constructor
+	 */
+	ofxOilFlowField();
+
+	/**
+	 * @brief Calculates the flow field of an image
+	 *
+	 * @param img the view of the image pixels
+	 */
+	void update(const ofxOilPixelView& img);
+
+	/**
+	 * @brief Removes the flow field
+	 */
+	void clear();
+
+	/**
+	 * @brief Returns the flow at a given position
+	 *
+	 * @param pos the position
+	 * @return the flow vector, or a zero vector if the position is outside the image
+	 */
+	glm::vec2 getFlow(const glm::vec2& pos) const;
+
+	/**
+	 * @brief Indicates if the flow field has been calculated
+	 *
+	 * @return true if the flow field has been calculated
+	 */
+	bool isAllocated() const;
+
+	/**
+	 * @brief Returns the flow field width
+	 *
+	 * @return the flow field width
+	 */
+	unsigned int getWidth() const;
+
+	/**
+	 * @brief Returns the flow field height
+	 *
+	 * @return the flow field height
+	 */
+	unsigned int getHeight() const;
+
+protected:
+
+	/**
+	 * @brief Smooths an array with a box filter
+	 *
+	 * @param values the array values
+	 * @param buffer an auxiliary array with the same size
+	 */
+	void boxFilter(vector<float>& values, vector<float>& buffer) const;
+
+	/**
+	 * @brief The flow field width
+	 */
+	unsigned int width;
+
+	/**
+	 * @brief The flow field height
+	 */
+	unsigned int height;
+
+	/**
+	 * @brief The flow vectors at each pixel
+	 */
+	vector<glm::vec2> flow;
+};
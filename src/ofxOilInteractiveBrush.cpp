@@ -0,0 +1,104 @@
+#include "ofxOilInteractiveBrush.h"
+#include "ofxOilBrush.h"
+#include "ofMain.h"
+
+float ofxOilInteractiveBrush::PAINTED_COLOR_MIX = 0.001;
+
+float ofxOilInteractiveBrush::INITIAL_COLOR_MIX_OVER_PAINT = 0.001;
+
+float ofxOilInteractiveBrush::INITIAL_COLOR_MIX = 0.05;
+
+float ofxOilInteractiveBrush::ALPHA_DECREMENT = 1;
+
+ofxOilInteractiveBrush::ofxOilInteractiveBrush() :
+		alpha(0), backgroundColor(255) {
+}
+
+void ofxOilInteractiveBrush::allocate(int width, int height, const ofColor& _backgroundColor) {
+	backgroundColor = _backgroundColor;
+	canvasPixels.allocate(width, height, OF_PIXELS_RGB);
+	canvasPixels.setColor(backgroundColor);
+}
+
+void ofxOilInteractiveBrush::setCanvasPixels(const ofPixels& pixels, const ofColor& _backgroundColor) {
+	backgroundColor = _backgroundColor;
+	canvasPixels = pixels;
+}
+
+void ofxOilInteractiveBrush::startStroke(const glm::vec2& position, float size) {
+	// Create a new brush
+	brush = ofxOilBrush(position, size);
+
+	// Reset the bristle colors
+	initialColors = vector<ofColor>(brush.getNBristles());
+	currentColors = initialColors;
+	alpha = 255;
+}
+
+void ofxOilInteractiveBrush::setBristleColors(const vector<ofColor>& colors) {
+	// Check that the input makes sense
+	unsigned int nBristles = brush.getNBristles();
+
+	if (colors.size() == 1) {
+		initialColors = vector<ofColor>(nBristles, colors[0]);
+	} else if (colors.size() == nBristles) {
+		initialColors = colors;
+	} else {
+		throw invalid_argument("There should be one color for each bristle in the brush or a single color.");
+	}
+
+	currentColors = initialColors;
+}
+
+void ofxOilInteractiveBrush::moveTo(const glm::vec2& position) {
+	// Update the brush position
+	brush.updatePosition(position, true);
+
+	// Mix the current bristle colors with the color under the bristles positions
+	ofxOilSpan<const glm::vec2> bristlePositions = brush.getBristlesPositions();
+	int width = canvasPixels.getWidth();
+	int height = canvasPixels.getHeight();
+
+	for (unsigned int i = 0; i < bristlePositions.size(); ++i) {
+		// Check that the bristle is inside the canvas
+		const glm::vec2& pos = bristlePositions[i];
+		int x = pos.x;
+		int y = pos.y;
+
+		if (x >= 0 && x < width && y >= 0 && y < height) {
+			// Get the color under the bristle
+			const ofColor& color = canvasPixels.getColor(x, y);
+
+			// Check if we are over a pixel that has been painted already
+			if (color != backgroundColor) {
+				// Mix the current bristle color with the painted color and add some of the initial color
+				currentColors[i].lerp(color, PAINTED_COLOR_MIX);
+				currentColors[i].lerp(initialColors[i], INITIAL_COLOR_MIX_OVER_PAINT);
+			} else {
+				// Add some of the initial color
+				currentColors[i].lerp(initialColors[i], INITIAL_COLOR_MIX);
+			}
+		}
+	}
+
+	// Decrease the alpha value in each step
+	alpha -= ALPHA_DECREMENT;
+
+	// Paint the brush on the current frame buffer and on the shadow canvas
+	if (alpha > 0) {
+		brush.paint(currentColors, alpha);
+		brush.paint(canvasPixels, currentColors, alpha);
+	}
+}
+
+bool ofxOilInteractiveBrush::hasPaint() const {
+	return alpha > 0;
+}
+
+unsigned int ofxOilInteractiveBrush::getNBristles() const {
+	return brush.getNBristles();
+}
+
+const ofPixels& ofxOilInteractiveBrush::getCanvasPixels() const {
+	return canvasPixels;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOilBrush.h"
+
+/**
+ * @brief Class that simulates a brush controlled by the user (e.g. with the mouse cursor)
+ *
+ * The brush keeps a CPU copy of the canvas (the shadow canvas) that is updated with its own strokes. This copy is
+ * used to pick the colors under the bristles, so the canvas never needs to be read back from the graphics card while
+ * painting.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilInteractiveBrush {
+public:
+
+	/**
+	 * @brief The fraction of the painted color that the bristles pick in each step
+	 */
+	static float PAINTED_COLOR_MIX;
+
+	/**
+	 * @brief The fraction of the initial bristle color that is recovered in each step over painted pixels
+	 */
+	static float INITIAL_COLOR_MIX_OVER_PAINT;
+
+	/**
+	 * @brief The fraction of the initial bristle color that is recovered in each step over unpainted pixels
+	 */
+	static float INITIAL_COLOR_MIX;
+
+	/**
+	 * @brief The alpha decrement applied in each step
+	 */
+	static float ALPHA_DECREMENT;
+
+	/**
+	 * @brief Constructor
+	 */
+	ofxOilInteractiveBrush();
+
+	/**
+	 * @brief Allocates the shadow canvas and fills it with the background color
+	 *
+	 * @param width the canvas width
+	 * @param height the canvas height
+	 * @param _backgroundColor the canvas background color
+	 */
+	void allocate(int width, int height, const ofColor& _backgroundColor);
+
+	/**
+	 * @brief Sets the shadow canvas pixels
+	 *
+	 * This should only be necessary when the canvas has been modified by something else than the brush.
+	 *
+	 * @param pixels the current canvas pixels
+	 * @param _backgroundColor the canvas background color
+	 */
+	void setCanvasPixels(const ofPixels& pixels, const ofColor& _backgroundColor);
+
+	/**
+	 * @brief Starts a new stroke with a new brush
+	 *
+	 * Note that setBristleColors should be called before the brush is moved.
+	 *
+	 * @param position the stroke starting position
+	 * @param size the brush size
+	 */
+	void startStroke(const glm::vec2& position, float size);
+
+	/**
+	 * @brief Sets the bristle colors at the start of the stroke
+	 *
+	 * @param colors the bristle colors. It should contain one color for each bristle or a single color for all of
+	 * them.
+	 */
+	void setBristleColors(const vector<ofColor>& colors);
+
+	/**
+	 * @brief Moves the brush to a new position along the current stroke and paints it
+	 *
+	 * The brush is painted on the currently bound frame buffer (e.g. between the canvas begin and end calls) and on
+	 * the shadow canvas.
+	 *
+	 * @param position the new brush position
+	 */
+	void moveTo(const glm::vec2& position);
+
+	/**
+	 * @brief Indicates if the brush still has paint in the current stroke
+	 *
+	 * @return true if the brush still has paint
+	 */
+	bool hasPaint() const;
+
+	/**
+	 * @brief Returns the number of bristles in the brush
+	 *
+	 * @return the number of bristles in the brush
+	 */
+	unsigned int getNBristles() const;
+
+	/**
+	 * @brief Returns the shadow canvas pixels
+	 *
+	 * @return the shadow canvas pixels
+	 */
+	const ofPixels& getCanvasPixels() const;
+
+protected:
+
+	/**
+	 * @brief The brush
+	 */
+	ofxOilBrush brush;
+
+	/**
+	 * @brief The bristle colors at the start of the stroke
+	 */
+	vector<ofColor> initialColors;
+
+	/**
+	 * @brief The current bristle colors
+	 */
+	vector<ofColor> currentColors;
+
+	/**
+	 * @brief The current alpha value
+	 */
+	float alpha;
+
+	/**
+	 * @brief The shadow canvas pixels
+	 */
+	ofPixels canvasPixels;
+
+	/**
+	 * @brief The canvas background color
+	 */
+	ofColor backgroundColor;
+};
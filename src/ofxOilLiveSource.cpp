@@ -0,0 +1,168 @@
+#include "ofxOilLiveSource.h"
+#include "ofxOilSimulator.h"
+#include "ofMain.h"
+#include <chrono>
+
+const unsigned int ofxOilLiveSource::NEW_FRAME_BIT = 4;
+
+ofxOilLiveSource::ofxOilLiveSource() :
+		mailbox(1), captureBuffer(0), receiveBuffer(2), running(false), nCapturedFrames(0), nDroppedFrames(0) {
+	captureTimes = { 0, 0, 0 };
+}
+
+ofxOilLiveSource::~ofxOilLiveSource() {
+	stop();
+}
+
+void ofxOilLiveSource::start(const FrameSource& source) {
+	// Check that the input makes sense
+	if (!source) {
+		throw invalid_argument("The frame source should be a valid function.");
+	}
+
+	// Stop the previous capture and empty the mailbox
+	stop();
+	frameSource = source;
+	mailbox = 1;
+	captureBuffer = 0;
+	receiveBuffer = 2;
+	nCapturedFrames = 0;
+	nDroppedFrames = 0;
+
+	// Start the capture thread
+	running = true;
+	captureThread = thread(&ofxOilLiveSource::captureFrames, this);
+}
+
+void ofxOilLiveSource::stop() {
+	{
+		lock_guard<mutex> lock(stopMutex);
+		running = false;
+	}
+
+	stopCondition.notify_all();
+
+	if (captureThread.joinable()) {
+		captureThread.join();
+	}
+}
+
+void ofxOilLiveSource::publishFrame(const ofPixels& pixels) {
+	// Check that the input makes sense
+	if (running) {
+		throw logic_error("The frames cannot be published while the capture thread is running.");
+	}
+
+	buffers[captureBuffer] = pixels;
+	publishCaptureBuffer();
+}
+
+bool ofxOilLiveSource::isRunning() const {
+	return running;
+}
+
+bool ofxOilLiveSource::receiveFrame() {
+	// Check if the mailbox contains a new frame
+	if ((mailbox.load(memory_order_acquire) & NEW_FRAME_BIT) == 0) {
+		return false;
+	}
+
+	// Swap the receive buffer with the mailbox buffer
+	receiveBuffer = mailbox.exchange(receiveBuffer, memory_order_acq_rel) & ~NEW_FRAME_BIT;
+	return true;
+}
+
+bool ofxOilLiveSource::update(ofxOilSimulator& simulator, bool clearCanvas) {
+	if (!receiveFrame() || !buffers[receiveBuffer].isAllocated()) {
+		return false;
+	}
+
+	simulator.setImagePixels(ofxOilPixelView(buffers[receiveBuffer]), clearCanvas);
+	return true;
+}
+
+const ofPixels& ofxOilLiveSource::getFrame() const {
+	return buffers[receiveBuffer];
+}
+
+double ofxOilLiveSource::getFrameAge() const {
+	return getTime() - captureTimes[receiveBuffer];
+}
+
+unsigned int ofxOilLiveSource::getNCapturedFrames() const {
+	return nCapturedFrames;
+}
+
+unsigned int ofxOilLiveSource::getNDroppedFrames() const {
+	return nDroppedFrames;
+}
+
+ofxOilLiveSource::FrameSource ofxOilLiveSource::createSyntheticSource(unsigned int width, unsigned int height,
+		float frameRate) {
+	// Check that the input makes sense
+	if (width == 0 || height == 0 || frameRate <= 0) {
+		throw invalid_argument("The frame dimensions and the frame rate should be higher than zero.");
+	}
+
+	unsigned int frameCounter = 0;
+	double nextFrameTime = getTime();
+
+	return [=](ofPixels& pixels) mutable {
+		// Wait until the next frame is due
+		double waitTime = nextFrameTime - getTime();
+
+		if (waitTime > 0) {
+			this_thread::sleep_for(chrono::duration<double>(waitTime));
+		}
+
+		nextFrameTime = max(nextFrameTime + 1 / frameRate, getTime());
+
+		// Draw a moving color gradient
+		pixels.allocate(width, height, OF_PIXELS_RGB);
+		unsigned char* data = pixels.getData();
+
+		for (unsigned int y = 0; y < height; ++y) {
+			for (unsigned int x = 0; x < width; ++x, data += 3) {
+				data[0] = (255 * x) / width + frameCounter;
+				data[1] = (255 * y) / height + 2 * frameCounter;
+				data[2] = (255 * (x + y)) / (width + height) - frameCounter;
+			}
+		}
+
+		++frameCounter;
+		return true;
+	};
+}
+
+void ofxOilLiveSource::captureFrames() {
+	while (running) {
+		// Capture a new frame in the capture buffer
+		if (!frameSource(buffers[captureBuffer])) {
+			// Wait a bit before trying again, unless the capture is stopped
+			unique_lock<mutex> lock(stopMutex);
+			stopCondition.wait_for(lock, chrono::milliseconds(1), [this]() {
+				return !running;
+			});
+			continue;
+		}
+
+		publishCaptureBuffer();
+	}
+}
+
+void ofxOilLiveSource::publishCaptureBuffer() {
+	captureTimes[captureBuffer] = getTime();
+	++nCapturedFrames;
+
+	// Publish the frame and take the buffer that was in the mailbox
+	unsigned int previous = mailbox.exchange(captureBuffer | NEW_FRAME_BIT, memory_order_acq_rel);
+	captureBuffer = previous & ~NEW_FRAME_BIT;
+
+	if (previous & NEW_FRAME_BIT) {
+		++nDroppedFrames;
+	}
+}
+
+double ofxOilLiveSource::getTime() {
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
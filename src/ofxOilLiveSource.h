@@ -0,0 +1,217 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOilSimulator.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Class that passes the frames of a live source to the painting thread
+ *
+ * The frames are passed to the painting thread through a lock-free single slot mailbox that always contains the
+ * latest captured frame. Frames that are not received before a newer frame arrives are dropped, so the painting
+ * always works with the most recent frame and the latency doesn't grow when the painting is slower than the
+ * capture.
+ *
+ * Thread safe sources can be captured in a background thread with the start method. Sources that must run in the
+ * main thread, like ofVideoGrabber, gain nothing from the capture thread, so their frames should be published
+ * directly with the publishFrame method.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilLiveSource {
+public:
+
+	/**
+	 * @brief The function type used to capture frames
+	 *
+	 * It is called repeatedly from the capture thread and should return true if a new frame was written in the given
+	 * pixels container. It should block until the next frame is available. If it returns false, the capture thread
+	 * waits a millisecond before calling it again. Only thread safe sources should be used.
+	 */
+	typedef function<bool(ofPixels&)> FrameSource;
+
+	/**
+	 * @brief Constructor
+	 */
+	ofxOilLiveSource();
+
+	/**
+	 * @brief Destructor. Stops the capture thread if it's running.
+	 */
+	~ofxOilLiveSource();
+
+	/**
+	 * @brief Starts capturing frames in a background thread
+	 *
+	 * @param source the function used to capture the frames
+	 */
+	void start(const FrameSource& source);
+
+	/**
+	 * @brief Stops the capture thread
+	 */
+	void stop();
+
+	/**
+	 * @brief Publishes a frame captured in the calling thread, without using the capture thread
+	 *
+	 * It can be called from the painting thread, and it cannot be used while the capture thread is running.
+	 *
+	 * @param pixels the captured frame
+	 */
+	void publishFrame(const ofPixels& pixels);
+
+	/**
+	 * @brief Indicates if the capture thread is running
+	 *
+	 * @return true if the capture thread is running
+	 */
+	bool isRunning() const;
+
+	/**
+	 * @brief Takes the latest captured frame from the mailbox if there is a new one
+	 *
+	 * @return true if a new frame was received
+	 */
+	bool receiveFrame();
+
+	/**
+	 * @brief Sets the latest captured frame as the simulator image if there is a new one
+	 *
+	 * The simulator samples the frame pixels in place, so the receiveFrame method should not be called directly while
+	 * the simulator is painting the frame.
+	 *
+	 * @param simulator the oil paint simulator
+	 * @param clearCanvas if true the canvas will be cleared before the painting starts
+	 * @return true if a new frame was sent to the simulator
+	 */
+	bool update(ofxOilSimulator& simulator, bool clearCanvas);
+
+	/**
+	 * @brief Returns the last received frame
+	 *
+	 * @return the last received frame
+	 */
+	const ofPixels& getFrame() const;
+
+	/**
+	 * @brief Returns the time since the last received frame was captured
+	 *
+	 * @return the last received frame age in seconds
+	 */
+	double getFrameAge() const;
+
+	/**
+	 * @brief Returns the number of frames captured since the capture started
+	 *
+	 * @return the number of captured frames
+	 */
+	unsigned int getNCapturedFrames() const;
+
+	/**
+	 * @brief Returns the number of captured frames that were dropped because a newer frame arrived
+	 *
+	 * @return the number of dropped frames
+	 */
+	unsigned int getNDroppedFrames() const;
+
+	/**
+	 * @brief Creates a frame source that generates synthetic frames, useful to test the painting without a camera
+	 *
+	 * The frames show a moving color gradient.
+	 *
+	 * @param width the frames width
+	 * @param height the frames height
+	 * @param frameRate the number of frames generated per second
+	 * @return the synthetic frame source
+	 */
+	static FrameSource createSyntheticSource(unsigned int width, unsigned int height, float frameRate);
+
+protected:
+
+	/**
+	 * @brief The capture thread loop
+	 */
+	void captureFrames();
+
+	/**
+	 * @brief Puts the frame in the capture buffer in the mailbox and takes the buffer that was in the mailbox
+	 */
+	void publishCaptureBuffer();
+
+	/**
+	 * @brief Returns the current time
+	 *
+	 * @return the current time in seconds
+	 */
+	static double getTime();
+
+	/**
+	 * @brief The mailbox bit that indicates that the mailbox slot contains a frame not received yet
+	 */
+	static const unsigned int NEW_FRAME_BIT;
+
+	/**
+	 * @brief The frame buffers. One is owned by the capture thread, one by the receiving thread and one by the
+	 * mailbox.
+	 */
+	array<ofPixels, 3> buffers;
+
+	/**
+	 * @brief The capture time of the frame in each buffer
+	 */
+	array<double, 3> captureTimes;
+
+	/**
+	 * @brief The buffer index in the mailbox, combined with the new frame bit
+	 */
+	atomic<unsigned int> mailbox;
+
+	/**
+	 * @brief The buffer index owned by the capture thread
+	 */
+	unsigned int captureBuffer;
+
+	/**
+	 * @brief The buffer index owned by the receiving thread
+	 */
+	unsigned int receiveBuffer;
+
+	/**
+	 * @brief The function used to capture the frames
+	 */
+	FrameSource frameSource;
+
+	/**
+	 * @brief The capture thread
+	 */
+	thread captureThread;
+
+	/**
+	 * @brief Indicates if the capture thread should keep running
+	 */
+	atomic<bool> running;
+
+	/**
+	 * @brief The mutex used to wait for the stop signal
+	 */
+	mutex stopMutex;
+
+	/**
+	 * @brief The condition variable that wakes up the capture thread when it should stop
+	 */
+	condition_variable stopCondition;
+
+	/**
+	 * @brief The number of captured frames
+	 */
+	atomic<unsigned int> nCapturedFrames;
+
+	/**
+	 * @brief The number of dropped frames
+	 */
+	atomic<unsigned int> nDroppedFrames;
+};
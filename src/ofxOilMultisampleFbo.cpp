@@ -0,0 +1,209 @@
+#include "ofxOilMultisampleFbo.h"
+#include "ofMain.h"
+
+ofxOilMultisampleFbo::ofxOilMultisampleFbo() :
+		width(0), height(0), framebuffer(0), previousFramebuffer(0) {
+}
+
+ofxOilMultisampleFbo::~ofxOilMultisampleFbo() {
+	clear();
+}
+
+ofxOilMultisampleFbo::ofxOilMultisampleFbo(ofxOilMultisampleFbo&& other) :
+		ofxOilMultisampleFbo() {
+	*this = move(other);
+}
+
+ofxOilMultisampleFbo& ofxOilMultisampleFbo::operator=(ofxOilMultisampleFbo&& other) {
+	if (this != &other) {
+		clear();
+		width = other.width;
+		height = other.height;
+		framebuffer = other.framebuffer;
+		textures = move(other.textures);
+		previousFramebuffer = other.previousFramebuffer;
+		sampleShader = move(other.sampleShader);
+		other.framebuffer = 0;
+		other.textures.clear();
+		other.width = 0;
+		other.height = 0;
+	}
+
+	return *this;
+}
+
+bool ofxOilMultisampleFbo::isSupported() {
+#ifdef TARGET_OPENGLES
+	return false;
+#else
+	return ofIsGLProgrammableRenderer();
+#endif
+}
+
+void ofxOilMultisampleFbo::allocate(int _width, int _height, int nSamples, int nColorBuffers) {
+	// Check that the input makes sense
+	if (!isSupported()) {
+		throw logic_error("The multisampled attachments need the programmable renderer and desktop OpenGL.");
+	} else if (_width <= 0 || _height <= 0 || nSamples <= 0 || nColorBuffers <= 0) {
+		throw invalid_argument("The dimensions, samples and color buffers should be higher than zero.");
+	}
+
+#ifndef TARGET_OPENGLES
+	// Release the previous attachments if necessary
+	clear();
+	width = _width;
+	height = _height;
+
+	// Create the multisampled textures and attach them to the framebuffer
+	GLint maxSamples;
+	glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &maxSamples);
+	nSamples = min(nSamples, int(maxSamples));
+	GLint previousTexture;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D_MULTISAMPLE, &previousTexture);
+	GLint currentFramebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &currentFramebuffer);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	textures = vector<GLuint>(nColorBuffers, 0);
+	glGenTextures(nColorBuffers, textures.data());
+
+	for (int i = 0; i < nColorBuffers; ++i) {
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textures[i]);
+		glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, nSamples, GL_RGBA8, width, height, GL_TRUE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D_MULTISAMPLE, textures[i], 0);
+	}
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, previousTexture);
+	glBindFramebuffer(GL_FRAMEBUFFER, currentFramebuffer);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		clear();
+		throw runtime_error("Could not create the multisampled framebuffer.");
+	}
+
+	// Load the resolve shader if necessary
+	if (!sampleShader.isLoaded()) {
+		setupSampleShader();
+	}
+#endif
+}
+
+void ofxOilMultisampleFbo::clear() {
+#ifndef TARGET_OPENGLES
+	if (!textures.empty()) {
+		glDeleteTextures(textures.size(), textures.data());
+		textures.clear();
+	}
+
+	if (framebuffer != 0) {
+		glDeleteFramebuffers(1, &framebuffer);
+		framebuffer = 0;
+	}
+#endif
+
+	width = 0;
+	height = 0;
+}
+
+bool ofxOilMultisampleFbo::isAllocated() const {
+	return framebuffer != 0;
+}
+
+void ofxOilMultisampleFbo::bind() {
+#ifndef TARGET_OPENGLES
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	vector<GLenum> drawBuffers;
+
+	for (unsigned int i = 0; i < textures.size(); ++i) {
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+
+	glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+#endif
+}
+
+void ofxOilMultisampleFbo::unbind() {
+#ifndef TARGET_OPENGLES
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+#endif
+}
+
+void ofxOilMultisampleFbo::resolve(ofFbo& target) {
+#ifndef TARGET_OPENGLES
+	// Average the samples of the first attachment
+	target.begin();
+	GLint targetFramebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	setDrawBuffer(0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, targetFramebuffer);
+
+	// Copy the first sample of the other attachments
+	ofPushStyle();
+	ofDisableAlphaBlending();
+	sampleShader.begin();
+
+	for (unsigned int i = 1; i < textures.size(); ++i) {
+		setDrawBuffer(i);
+		sampleShader.setUniformTexture("samples", GL_TEXTURE_2D_MULTISAMPLE, textures[i], 0);
+		ofDrawRectangle(0, 0, width, height);
+	}
+
+	sampleShader.end();
+	ofPopStyle();
+	target.activateAllDrawBuffers();
+	target.end();
+#endif
+}
+
+void ofxOilMultisampleFbo::load(ofFbo& source) {
+	// Draw the source textures covering all the pixel samples
+	source.begin();
+	bind();
+	ofPushStyle();
+	ofDisableAlphaBlending();
+	ofSetColor(255);
+
+	for (unsigned int i = 0; i < textures.size(); ++i) {
+		setDrawBuffer(i);
+		source.getTexture(i).draw(0, 0);
+	}
+
+	ofPopStyle();
+	unbind();
+	source.end();
+}
+
+void ofxOilMultisampleFbo::setupSampleShader() {
+	sampleShader.setupShaderFromSource(GL_VERTEX_SHADER, R"(
+		#version 330
+		uniform mat4 modelViewProjectionMatrix;
+		in vec4 position;
+
+		void main() {
+			gl_Position = modelViewProjectionMatrix * position;
+		}
+	)");
+	sampleShader.setupShaderFromSource(GL_FRAGMENT_SHADER, R"(
+		#version 330
+		uniform sampler2DMS samples;
+		out vec4 fragColor;
+
+		void main() {
+			fragColor = texelFetch(samples, ivec2(gl_FragCoord.xy), 0);
+		}
+	)");
+	sampleShader.bindDefaults();
+	sampleShader.linkProgram();
+}
+
+void ofxOilMultisampleFbo::setDrawBuffer(unsigned int attachment) {
+#ifndef TARGET_OPENGLES
+	GLenum drawBuffer = GL_COLOR_ATTACHMENT0 + attachment;
+	glDrawBuffers(1, &drawBuffer);
+#endif
+}
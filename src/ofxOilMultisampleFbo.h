@@ -0,0 +1,147 @@
+#pragma once
+
+#include "ofMain.h"
+
+/**
+ * @brief Class that paints on multisampled color attachments and resolves them into a single sampled ofFbo
+ *
+ * The first color attachment is resolved averaging its samples, so it's antialiased. The other color attachments
+ * are resolved copying the first sample of each pixel, so their values are the same that a single sampled attachment
+ * would get. This allows to paint in the same pass an antialiased canvas and a buffer with exact opaque colors.
+ *
+ * It needs multisampled textures, so it's only supported with the programmable renderer and desktop OpenGL.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilMultisampleFbo {
+public:
+
+	/**
+	 * @brief Constructor
+	 */
+	ofxOilMultisampleFbo();
+
+	/**
+	 * @brief Destructor
+	 */
+	~ofxOilMultisampleFbo();
+
+	ofxOilMultisampleFbo(const ofxOilMultisampleFbo&) = delete;
+
+	ofxOilMultisampleFbo& operator=(const ofxOilMultisampleFbo&) = delete;
+
+	/**
+	 * @brief Move constructor. The other object loses its GL objects.
+	 *
+	 * @param other the object to move
+	 */
+	ofxOilMultisampleFbo(ofxOilMultisampleFbo&& other);
+
+	/**
+	 * @brief Move assignment operator. The other object loses its GL objects.
+	 *
+	 * @param other the object to move
+	 * @return this object
+	 */
+	ofxOilMultisampleFbo& operator=(ofxOilMultisampleFbo&& other);
+
+	/**
+	 * @brief Indicates if the multisampled attachments are supported by the current renderer
+	 *
+	 * @return true if the multisampled attachments are supported
+	 */
+	static bool isSupported();
+
+	/**
+	 * @brief Allocates the multisampled color attachments
+	 *
+	 * @param _width the attachments width
+	 * @param _height the attachments height
+	 * @param nSamples the number of samples per pixel. It will be limited to the maximum supported value.
+	 * @param nColorBuffers the number of color attachments
+	 */
+	void allocate(int _width, int _height, int nSamples, int nColorBuffers);
+
+	/**
+	 * @brief Releases the GL objects
+	 */
+	void clear();
+
+	/**
+	 * @brief Indicates if the color attachments are allocated
+	 *
+	 * @return true if the color attachments are allocated
+	 */
+	bool isAllocated() const;
+
+	/**
+	 * @brief Binds the multisampled attachments as the current framebuffer, with all of them active
+	 *
+	 * It should be called after the begin method of the single sampled ofFbo, so the viewport and the matrices are
+	 * set for it.
+	 */
+	void bind();
+
+	/**
+	 * @brief Binds again the framebuffer that was bound before the bind method was called
+	 */
+	void unbind();
+
+	/**
+	 * @brief Resolves the multisampled attachments into the single sampled ofFbo attachments
+	 *
+	 * @param target the single sampled ofFbo. It should have the same dimensions and number of color attachments.
+	 */
+	void resolve(ofFbo& target);
+
+	/**
+	 * @brief Copies the single sampled ofFbo attachments into all the samples of the multisampled attachments
+	 *
+	 * @param source the single sampled ofFbo. It should have the same dimensions and number of color attachments.
+	 */
+	void load(ofFbo& source);
+
+protected:
+
+	/**
+	 * @brief Loads the shader that copies the first sample of each pixel
+	 */
+	void setupSampleShader();
+
+	/**
+	 * @brief Sets the active draw buffer
+	 *
+	 * @param attachment the color attachment index
+	 */
+	static void setDrawBuffer(unsigned int attachment);
+
+	/**
+	 * @brief The attachments width
+	 */
+	int width;
+
+	/**
+	 * @brief The attachments height
+	 */
+	int height;
+
+	/**
+	 * @brief The framebuffer object
+	 */
+	GLuint framebuffer;
+
+	/**
+	 * @brief The multisampled textures used as color attachments
+	 */
+	vector<GLuint> textures;
+
+	/**
+	 * @brief The framebuffer that was bound before the bind method was called
+	 */
+	GLint previousFramebuffer;
+
+	/**
+	 * @brief The shader that copies the first sample of each pixel
+	 */
+	ofShader sampleShader;
+};
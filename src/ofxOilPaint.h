@@ -1,6 +1,22 @@
 #pragma once
 
+#include "ofxOilRandom.h"
+#include "ofxOilSerialization.h"
+#include "ofxOilSpan.h"
+#include "ofxOilBitMask.h"
+#include "ofxOilPixelView.h"
+#include "ofxOilFlowField.h"
+#include "ofxOilStampCache.h"
 #include "ofxOilBristle.h"
 #include "ofxOilBrush.h"
+#include "ofxOilTrajectoryLibrary.h"
 #include "ofxOilTrace.h"
+#include "ofxOilInteractiveBrush.h"
+#include "ofxOilMultisampleFbo.h"
 #include "ofxOilSimulator.h"
+#include "ofxOilLiveSource.h"
+#include "ofxOilVideoRenderer.h"
+#include "ofxOilBoundedQueue.h"
+#include "ofxOilWorkerPool.h"
+#include "ofxOilVideoPipeline.h"
+#include "ofxOilTiledPixels.h"
@@ -0,0 +1,91 @@
+#include "ofxOilPixelView.h"
+#include "ofMain.h"
+
+ofxOilPixelView::ofxOilPixelView(const unsigned char* _data, unsigned int _width, unsigned int _height,
+		unsigned int _stride, ChannelOrder _order) :
+		data(_data), width(_width), height(_height) {
+	// Set the channel positions
+	switch (_order) {
+	case ChannelOrder::GRAY:
+		nChannels = 1;
+		redIndex = greenIndex = blueIndex = alphaIndex = 0;
+		break;
+	case ChannelOrder::RGB:
+	case ChannelOrder::RGBA:
+		nChannels = _order == ChannelOrder::RGB ? 3 : 4;
+		redIndex = 0;
+		greenIndex = 1;
+		blueIndex = 2;
+		alphaIndex = 3;
+		break;
+	default:
+		nChannels = _order == ChannelOrder::BGR ? 3 : 4;
+		redIndex = 2;
+		greenIndex = 1;
+		blueIndex = 0;
+		alphaIndex = 3;
+		break;
+	}
+
+	stride = _stride > 0 ? _stride : width * nChannels;
+
+	// Check that the input makes sense
+	if (stride < width * nChannels) {
+		throw invalid_argument("The stride should be at least the width times the number of channels.");
+	} else if (data == nullptr && width > 0 && height > 0) {
+		throw invalid_argument("The image data cannot be null.");
+	}
+}
+
+ofxOilPixelView::ofxOilPixelView(const ofPixels& pixels) :
+		ofxOilPixelView(pixels.getData(), pixels.getWidth(), pixels.getHeight(), pixels.getBytesStride(),
+				getChannelOrder(pixels)) {
+}
+
+void ofxOilPixelView::toPixels(ofPixels& pixels) const {
+	pixels.allocate(width, height, OF_PIXELS_RGB);
+	unsigned char* pixelsData = pixels.getData();
+
+	for (unsigned int y = 0; y < height; ++y) {
+		for (unsigned int x = 0; x < width; ++x, pixelsData += 3) {
+			const unsigned char* pixel = data + size_t(y) * stride + size_t(x) * nChannels;
+			pixelsData[0] = pixel[redIndex];
+			pixelsData[1] = pixel[greenIndex];
+			pixelsData[2] = pixel[blueIndex];
+		}
+	}
+}
+
+unsigned int ofxOilPixelView::getWidth() const {
+	return width;
+}
+
+unsigned int ofxOilPixelView::getHeight() const {
+	return height;
+}
+
+bool ofxOilPixelView::isValid() const {
+	return data != nullptr && width > 0 && height > 0;
+}
+
+ofxOilPixelView::ChannelOrder ofxOilPixelView::getChannelOrder(const ofPixels& pixels) {
+	// Empty pixels containers produce an invalid view
+	if (!pixels.isAllocated()) {
+		return ChannelOrder::RGB;
+	}
+
+	switch (pixels.getPixelFormat()) {
+	case OF_PIXELS_GRAY:
+		return ChannelOrder::GRAY;
+	case OF_PIXELS_RGB:
+		return ChannelOrder::RGB;
+	case OF_PIXELS_BGR:
+		return ChannelOrder::BGR;
+	case OF_PIXELS_RGBA:
+		return ChannelOrder::RGBA;
+	case OF_PIXELS_BGRA:
+		return ChannelOrder::BGRA;
+	default:
+		throw invalid_argument("The pixels format should be GRAY, RGB, BGR, RGBA or BGRA.");
+	}
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "ofMain.h"
+
+/**
+ * @brief Class that gives access to the pixels of an image stored in memory that it doesn't own
+ *
+ * The view only keeps a pointer to the image data, so the data should stay valid while the view is used. The rows
+ * can be padded, and the color channels can be stored in different orders.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilPixelView {
+public:
+
+	/**
+	 * @brief The supported channel orders
+	 */
+	enum class ChannelOrder {
+		/**
+		 * @brief One gray channel
+		 */
+		GRAY,
+
+		/**
+		 * @brief Red, green and blue channels
+		 */
+		RGB,
+
+		/**
+		 * @brief Blue, green and red channels
+		 */
+		BGR,
+
+		/**
+		 * @brief Red, green, blue and alpha channels
+		 */
+		RGBA,
+
+		/**
+		 * @brief Blue, green, red and alpha channels
+		 */
+		BGRA
+	};
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param _data the image data
+	 * @param _width the image width
+	 * @param _height the image height
+	 * @param _stride the number of bytes between the start of two consecutive rows. 0 means no padding.
+	 * @param _order the channel order
+	 */
+	ofxOilPixelView(const unsigned char* _data = nullptr, unsigned int _width = 0, unsigned int _height = 0,
+			unsigned int _stride = 0, ChannelOrder _order = ChannelOrder::RGB);
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param pixels the pixels container. Its format should be GRAY, RGB, BGR, RGBA or BGRA.
+	 */
+	ofxOilPixelView(const ofPixels& pixels);
+
+	/**
+	 * @brief Returns the pixel color at a given position
+	 *
+	 * Note that the position is not checked to be inside the image.
+	 *
+	 * @param x the pixel x position
+	 * @param y the pixel y position
+	 * @return the pixel color
+	 */
+	ofColor getColor(unsigned int x, unsigned int y) const;
+
+	/**
+	 * @brief Copies the view pixels in a pixels container with RGB channels
+	 *
+	 * @param pixels the pixels container
+	 */
+	void toPixels(ofPixels& pixels) const;
+
+	/**
+	 * @brief Returns the image width
+	 *
+	 * @return the image width
+	 */
+	unsigned int getWidth() const;
+
+	/**
+	 * @brief Returns the image height
+	 *
+	 * @return the image height
+	 */
+	unsigned int getHeight() const;
+
+	/**
+	 * @brief Indicates if the view points to some image data
+	 *
+	 * @return true if the view points to some image data
+	 */
+	bool isValid() const;
+
+protected:
+
+	/**
+	 * @brief Returns the channel order of a pixels container
+	 *
+	 * @param pixels the pixels container
+	 * @return the channel order that corresponds to the pixels format
+	 */
+	static ChannelOrder getChannelOrder(const ofPixels& pixels);
+
+	/**
+	 * @brief The image data
+	 */
+	const unsigned char* data;
+
+	/**
+	 * @brief The image width
+	 */
+	unsigned int width;
+
+	/**
+	 * @brief The image height
+	 */
+	unsigned int height;
+
+	/**
+	 * @brief The number of bytes between the start of two consecutive rows
+	 */
+	unsigned int stride;
+
+	/**
+	 * @brief The number of channels per pixel
+	 */
+	unsigned int nChannels;
+
+	/**
+	 * @brief The red channel position inside the pixel
+	 */
+	unsigned int redIndex;
+
+	/**
+	 * @brief The green channel position inside the pixel
+	 */
+	unsigned int greenIndex;
+
+	/**
+	 * @brief The blue channel position inside the pixel
+	 */
+	unsigned int blueIndex;
+
+	/**
+	 * @brief The alpha channel position inside the pixel
+	 */
+	unsigned int alphaIndex;
+};
+
+inline ofColor ofxOilPixelView::getColor(unsigned int x, unsigned int y) const {
+	const unsigned char* pixel = data + size_t(y) * stride + size_t(x) * nChannels;
+	return ofColor(pixel[redIndex], pixel[greenIndex], pixel[blueIndex], nChannels == 4 ? pixel[alphaIndex] : 255);
+}
@@ -0,0 +1,24 @@
+#include "ofxOilRandom.h"
+#include "ofMain.h"
+
+mt19937& ofxOilGetRandomEngine() {
+	thread_local mt19937 engine(random_device { }());
+	return engine;
+}
+
+void ofxOilSeedRandom(unsigned int seed) {
+	ofxOilGetRandomEngine().seed(seed);
+}
+
+float ofxOilRandom(float max) {
+	return ofxOilRandom(0, max);
+}
+
+float ofxOilRandom(float min, float max) {
+	// Use the 32 bits of the engine output to get a value in the range [0, 1)
+	double value = ofxOilGetRandomEngine()() / 4294967296.0;
+	float result = min + (max - min) * value;
+
+	// Protect against rounding errors when converting to float
+	return result < max || max <= min ? result : nextafter(max, min);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ofMain.h"
+
+/**
+ * @brief Returns the random number engine used by the addon in the current thread
+ *
+ * Each thread has its own engine, so simulations running in different threads don't interfere with each other. The
+ * engine is seeded from std::random_device the first time it is used, unless ofxOilSeedRandom is called before.
+ * Note that ofSeedRandom has no effect on this engine.
+ *
+ * @return the current thread random number engine
+ */
+mt19937& ofxOilGetRandomEngine();
+
+/**
+ * @brief Seeds the random number engine used by the addon in the current thread
+ *
+ * @param seed the seed to use
+ */
+void ofxOilSeedRandom(unsigned int seed);
+
+/**
+ * @brief Returns a random number between zero and the given value
+ *
+ * @param max the maximum value (excluded)
+ * @return a random number in the range [0, max)
+ */
+float ofxOilRandom(float max);
+
+/**
+ * @brief Returns a random number between two values
+ *
+ * @param min the minimum value
+ * @param max the maximum value (excluded)
+ * @return a random number in the range [min, max)
+ */
+float ofxOilRandom(float min, float max);
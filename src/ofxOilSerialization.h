@@ -0,0 +1,160 @@
+#pragma once
+
+#include "ofMain.h"
+
+/**
+ * @brief Returns the number of bytes left in a binary stream
+ *
+ * It's used to check the saved container sizes before allocating them, so a corrupted size doesn't cause a huge
+ * allocation.
+ *
+ * @param in the input stream
+ * @return the number of bytes left, or the maximum possible value if the stream is not seekable
+ */
+inline uint64_t ofxOilGetRemainingBytes(istream& in) {
+	istream::pos_type position = in.tellg();
+
+	if (position == istream::pos_type(-1)) {
+		return numeric_limits<uint64_t>::max();
+	}
+
+	in.seekg(0, ios::end);
+	istream::pos_type end = in.tellg();
+	in.seekg(position);
+
+	if (end == istream::pos_type(-1)) {
+		return numeric_limits<uint64_t>::max();
+	}
+
+	return uint64_t(end - position);
+}
+
+/**
+ * @brief Writes a trivially copyable value to a binary stream
+ *
+ * @param out the output stream
+ * @param value the value to write
+ */
+template<typename T>
+inline void ofxOilWrite(ostream& out, const T& value) {
+	static_assert(is_trivially_copyable<T>::value, "Only trivially copyable types can be written directly.");
+	out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+ * @brief Reads a trivially copyable value from a binary stream
+ *
+ * @param in the input stream
+ * @param value the value to read
+ */
+template<typename T>
+inline void ofxOilRead(istream& in, T& value) {
+	static_assert(is_trivially_copyable<T>::value, "Only trivially copyable types can be read directly.");
+	in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+/**
+ * @brief Writes a vector of trivially copyable values to a binary stream
+ *
+ * @param out the output stream
+ * @param values the values to write
+ */
+template<typename T>
+inline void ofxOilWrite(ostream& out, const vector<T>& values) {
+	static_assert(is_trivially_copyable<T>::value, "Only trivially copyable types can be written directly.");
+	ofxOilWrite(out, uint64_t(values.size()));
+	out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+/**
+ * @brief Reads a vector of trivially copyable values from a binary stream
+ *
+ * @param in the input stream
+ * @param values the values to read
+ */
+template<typename T>
+inline void ofxOilRead(istream& in, vector<T>& values) {
+	static_assert(is_trivially_copyable<T>::value, "Only trivially copyable types can be read directly.");
+	uint64_t size = 0;
+	ofxOilRead(in, size);
+
+	if (!in || size > ofxOilGetRemainingBytes(in) / sizeof(T)) {
+		throw runtime_error("Unexpected end of stream while reading a vector.");
+	}
+
+	values.resize(size);
+	in.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(T));
+}
+
+/**
+ * @brief Writes a vector of vectors of trivially copyable values to a binary stream
+ *
+ * @param out the output stream
+ * @param values the values to write
+ */
+template<typename T>
+inline void ofxOilWrite(ostream& out, const vector<vector<T>>& values) {
+	ofxOilWrite(out, uint64_t(values.size()));
+
+	for (const vector<T>& v : values) {
+		ofxOilWrite(out, v);
+	}
+}
+
+/**
+ * @brief Reads a vector of vectors of trivially copyable values from a binary stream
+ *
+ * @param in the input stream
+ * @param values the values to read
+ */
+template<typename T>
+inline void ofxOilRead(istream& in, vector<vector<T>>& values) {
+	uint64_t size = 0;
+	ofxOilRead(in, size);
+
+	// Each vector needs at least the bytes of its size
+	if (!in || size > ofxOilGetRemainingBytes(in) / sizeof(uint64_t)) {
+		throw runtime_error("Unexpected end of stream while reading a vector.");
+	}
+
+	values.resize(size);
+
+	for (vector<T>& v : values) {
+		ofxOilRead(in, v);
+	}
+}
+
+/**
+ * @brief Writes a pixels container to a binary stream
+ *
+ * @param out the output stream
+ * @param pixels the pixels to write
+ */
+inline void ofxOilWrite(ostream& out, const ofPixels& pixels) {
+	ofxOilWrite(out, uint32_t(pixels.getWidth()));
+	ofxOilWrite(out, uint32_t(pixels.getHeight()));
+	ofxOilWrite(out, uint32_t(pixels.getNumChannels()));
+	out.write(reinterpret_cast<const char*>(pixels.getData()), pixels.getTotalBytes());
+}
+
+/**
+ * @brief Reads a pixels container from a binary stream
+ *
+ * @param in the input stream
+ * @param pixels the pixels to read
+ */
+inline void ofxOilRead(istream& in, ofPixels& pixels) {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t nChannels = 0;
+	ofxOilRead(in, width);
+	ofxOilRead(in, height);
+	ofxOilRead(in, nChannels);
+
+	if (!in || uint64_t(width) * height * nChannels > ofxOilGetRemainingBytes(in)) {
+		throw runtime_error("Unexpected end of stream while reading the pixels.");
+	}
+
+	pixels.allocate(width, height, nChannels);
+	in.read(reinterpret_cast<char*>(pixels.getData()), pixels.getTotalBytes());
+}
@@ -1,6 +1,11 @@
 #include "ofxOilSimulator.h"
 #include "ofxOilTrace.h"
+#include "ofxOilBitMask.h"
+#include "ofxOilRandom.h"
+#include "ofxOilSerialization.h"
+#include "ofxOilWorkerPool.h"
 #include "ofMain.h"
+#include <future>
 
 float ofxOilSimulator::SMALLER_BRUSH_SIZE = 4;
 
@@ -14,6 +19,22 @@ unsigned int ofxOilSimulator::MAX_INVALID_TRACES = 250;
 
 unsigned int ofxOilSimulator::MAX_INVALID_TRACES_FOR_SMALLER_SIZE = 350;
 
+float ofxOilSimulator::MIN_BAD_PAINTED_REDUCTION_RATE = 0;
+
+unsigned int ofxOilSimulator::CONVERGENCE_WINDOW = 2000;
+
+unsigned int ofxOilSimulator::MAX_FAILED_STARTS_PER_REGION = 0;
+
+float ofxOilSimulator::RELATIVE_FAILED_STARTS_REGION_SIZE = 0.5;
+
+float ofxOilSimulator::DETAIL_BRUSH_SIZE = 10;
+
+unsigned int ofxOilSimulator::DETAIL_BLOCK_SIZE = 8;
+
+unsigned char ofxOilSimulator::MIN_DETAIL = 0;
+
+unsigned int ofxOilSimulator::DETAIL_SAMPLING_CHOICES = 1;
+
 float ofxOilSimulator::TRACE_SPEED = 2;
 
 float ofxOilSimulator::RELATIVE_TRACE_LENGTH = 2.3;
@@ -46,9 +67,56 @@ float ofxOilSimulator::MIN_BAD_PAINTED_REDUCTION_FRACTION = 0.45; // 0.45 - 0.3
 
 float ofxOilSimulator::MAX_WELL_PAINTED_DESTRUCTION_FRACTION = 0.4; // 0.4 - 0.55 - 0.4
 
-ofxOilSimulator::ofxOilSimulator(bool _useCanvasBuffer, bool _verbose) :
-		useCanvasBuffer(_useCanvasBuffer), verbose(_verbose) {
+unsigned int ofxOilSimulator::READBACK_BUFFERS = 3;
+
+unsigned int ofxOilSimulator::CANDIDATE_TRACES = 1;
+
+bool ofxOilSimulator::USE_RIBBON_RENDERER = false;
+
+bool ofxOilSimulator::USE_FLOW_FIELD = false;
+
+bool ofxOilSimulator::USE_EARLY_TRACE_DECISION = false;
+
+unsigned int ofxOilSimulator::MIN_EARLY_DECISION_SAMPLES = 128;
+
+unsigned int ofxOilSimulator::EARLY_DECISION_INTERVAL = 32;
+
+float ofxOilSimulator::EARLY_DECISION_CONFIDENCE = 3;
+
+const uint32_t ofxOilSimulator::CHECKPOINT_VERSION = 6;
+
+ofxOilSimulator::ofxOilSimulator(bool _useCanvasBuffer, bool _verbose, bool _asyncReadback, bool _cpuCanvas) :
+		useCanvasBuffer(_useCanvasBuffer), verbose(_verbose), asyncReadback(_asyncReadback), cpuCanvas(_cpuCanvas) {
+#ifdef TARGET_OPENGLES
+	// Pixel pack buffers are not available in OpenGL ES
+	asyncReadback = false;
+#endif
+
+	// The canvas pixels can be accessed directly if they are in the CPU
+	if (cpuCanvas) {
+		asyncReadback = false;
+	}
+
+	canvasTextureIsOutdated = false;
+	imgTextureIsOutdated = false;
+
+	nReadbacks = 0;
+	nConsumedReadbacks = 0;
+	paintedPixelsAreOutdated = true;
+	absErrorSums = { 0, 0, 0 };
+	sqErrorSums = { 0, 0, 0 };
+	errorSumsAreValid = false;
+	logPaintingQuality = false;
+	paintingStartTime = 0;
 	nBadPaintedPixels = 0;
+	nStartingPixels = 0;
+	nMaskedPixels = 0;
+	convergenceWork = 0;
+	convergenceBadPixels = 0;
+	failedStartsRegionSize = 1;
+	failedStartsRegionsPerRow = 0;
+	detailBlockSize = 1;
+	detailBlocksPerRow = 0;
 	averageBrushSize = SMALLER_BRUSH_SIZE;
 	paintingIsFinised = true;
 	obtainNewTrace = false;
@@ -57,46 +125,294 @@ ofxOilSimulator::ofxOilSimulator(bool _useCanvasBuffer, bool _verbose) :
 }
 
 void ofxOilSimulator::setImagePixels(const ofPixels& imagePixels, bool clearCanvas) {
-	// Set the image pixels
-	img = ofImage(imagePixels);
+	// Keep a copy of the pixels and paint them through a view
+	imgPixelsCopy = imagePixels;
+	setImagePixels(ofxOilPixelView(imgPixelsCopy), clearCanvas);
+}
+
+void ofxOilSimulator::setImagePixels(const ofxOilPixelView& imageView, bool clearCanvas) {
+	// Check that the input makes sense
+	if (!imageView.isValid()) {
+		throw invalid_argument("The image view doesn't point to any image data.");
+	}
+
+	// Set the image view. The image texture will be created when it's needed.
+	img = imageView;
+	imgTextureIsOutdated = true;
 	int imgWidth = img.getWidth();
 	int imgHeight = img.getHeight();
 
 	// Initialize the canvas and pixel containers if necessary
-	if (clearCanvas || imgWidth != canvas.getWidth() || imgHeight != canvas.getHeight()) {
+	int canvasWidth = cpuCanvas ? canvasPixels.getWidth() : canvas.getWidth();
+	int canvasHeight = cpuCanvas ? canvasPixels.getHeight() : canvas.getHeight();
+
+	if (clearCanvas || imgWidth != canvasWidth || imgHeight != canvasHeight) {
 		// Initialize the canvas where the image will be painted
-		canvas.allocate(imgWidth, imgHeight, GL_RGB, 2);
-		canvas.begin();
-		ofClear(BACKGROUND_COLOR);
-		canvas.end();
+		allocateCanvas(imgWidth, imgHeight);
 
-		// Initialize the canvas buffer if necessary
-		if (useCanvasBuffer) {
-			canvasBuffer.allocate(imgWidth, imgHeight, GL_RGB);
-			canvasBuffer.begin();
-			ofClear(BACKGROUND_COLOR);
-			canvasBuffer.end();
+		// Initialize all the pixel arrays
+		visitedPixels.allocate(imgWidth, imgHeight);
+		allocatePixelArrays(imgWidth, imgHeight);
+
+		// Keep the mask only if it still matches the image dimensions
+		if (maskPixels.isAllocated()
+				&& (int(maskPixels.getWidth()) != imgWidth || int(maskPixels.getHeight()) != imgHeight)) {
+			maskPixels.clear();
 		}
 
-		// Initialize all the pixel arrays
-		visitedPixels.allocate(imgWidth, imgHeight, OF_PIXELS_GRAY);
-		similarColorPixels.allocate(imgWidth, imgHeight, OF_PIXELS_GRAY);
-		badPaintedPixels = vector<unsigned int>(imgWidth * imgHeight);
-		nBadPaintedPixels = 0;
+		updateMaskSpans();
 	}
 
 	// Initialize the rest of the simulator variables
-	averageBrushSize = max(SMALLER_BRUSH_SIZE, max(imgWidth, imgHeight) / 6.0f);
+	averageBrushSize = max(SMALLER_BRUSH_SIZE, max(maskBounds.getWidth(), maskBounds.getHeight()) / 6.0f);
+	updateDetailMap();
+	updateFlowField();
+	resetFailedStarts();
+	convergenceWork = 0;
+	convergenceBadPixels = nMaskedPixels;
+	errorSumsAreValid = false;
+	paintingStartTime = ofGetElapsedTimef();
+	qualityCurve.clear();
 	paintingIsFinised = false;
 	obtainNewTrace = true;
 	traceStep = 0;
 	nTraces = 0;
 }
 
+void ofxOilSimulator::allocateCanvas(int width, int height) {
+	if (cpuCanvas) {
+		// Initialize the canvas pixels where the image will be painted
+		canvasPixels.allocate(width, height, OF_PIXELS_RGB);
+		canvasPixels.setColor(BACKGROUND_COLOR);
+		canvasTextureIsOutdated = true;
+
+		if (useCanvasBuffer) {
+			canvasBufferPixels = canvasPixels;
+		}
+	} else {
+		// Initialize the canvas where the image will be painted. The canvas buffer, if used, is a second color
+		// attachment, so both can be painted in the same pass. In that case they are painted on separate
+		// multisampled attachments, since the ofFbo resolve would blend the buffer opaque colors at the trace edges.
+		ofFboSettings settings;
+		settings.width = width;
+		settings.height = height;
+		settings.internalformat = GL_RGB;
+		settings.numSamples = useCanvasBuffer ? 0 : 2;
+		settings.numColorbuffers = useCanvasBuffer ? 2 : 1;
+		canvas.allocate(settings);
+
+		if (useCanvasBuffer && ofxOilMultisampleFbo::isSupported()) {
+			multisampleCanvas.allocate(width, height, 2, 2);
+		} else {
+			multisampleCanvas.clear();
+		}
+
+		canvas.begin();
+		canvas.activateAllDrawBuffers();
+		ofClear(BACKGROUND_COLOR);
+
+		if (multisampleCanvas.isAllocated()) {
+			multisampleCanvas.bind();
+			ofClear(BACKGROUND_COLOR);
+			multisampleCanvas.unbind();
+		}
+
+		canvas.end();
+	}
+
+	// Reset the readback ring and the error sums, since they are not valid anymore
+	readbackBuffers.clear();
+	nReadbacks = 0;
+	nConsumedReadbacks = 0;
+	dirtyRegion = ofRectangle();
+	errorSumsAreValid = false;
+	paintedPixelsAreOutdated = true;
+
+	// Load the canvas shader if necessary
+	if (useCanvasBuffer && !cpuCanvas && !canvasShader.isLoaded()) {
+		setupCanvasShader();
+	}
+}
+
+void ofxOilSimulator::setupCanvasShader() {
+	// The canvas gets the bristle colors with their alpha values, while the canvas buffer gets them totally opaque,
+	// and only if their alpha is high enough. The ribbons alphas are boosted, so they indicate it in their texture
+	// coordinates instead.
+	if (ofIsGLProgrammableRenderer()) {
+		canvasShader.setupShaderFromSource(GL_VERTEX_SHADER, R"(
+			#version 330
+			uniform mat4 modelViewProjectionMatrix;
+			uniform vec4 globalColor;
+			uniform float usingColors;
+			in vec4 position;
+			in vec4 color;
+			in vec2 texcoord;
+			out vec4 vertexColor;
+			out float bufferFlag;
+
+			void main() {
+				vertexColor = usingColors > 0.5 ? color : globalColor;
+				bufferFlag = texcoord.y;
+				gl_Position = modelViewProjectionMatrix * position;
+			}
+		)");
+		canvasShader.setupShaderFromSource(GL_FRAGMENT_SHADER, R"(
+			#version 330
+			uniform float minAlpha;
+			uniform float ribbonMode;
+			in vec4 vertexColor;
+			in float bufferFlag;
+			layout(location = 0) out vec4 canvasColor;
+			layout(location = 1) out vec4 canvasBufferColor;
+
+			void main() {
+				bool paintBuffer = ribbonMode > 0.5 ? bufferFlag > 0.5 : vertexColor.a >= minAlpha;
+				canvasColor = vertexColor;
+				canvasBufferColor = vec4(vertexColor.rgb, paintBuffer ? 1.0 : 0.0);
+			}
+		)");
+		canvasShader.bindDefaults();
+	} else {
+		canvasShader.setupShaderFromSource(GL_FRAGMENT_SHADER, R"(
+			#version 120
+			uniform float minAlpha;
+			uniform float ribbonMode;
+
+			void main() {
+				bool paintBuffer = ribbonMode > 0.5 ? gl_TexCoord[0].y > 0.5 : gl_Color.a >= minAlpha;
+				gl_FragData[0] = gl_Color;
+				gl_FragData[1] = vec4(gl_Color.rgb, paintBuffer ? 1.0 : 0.0);
+			}
+		)");
+	}
+
+	canvasShader.linkProgram();
+}
+
+void ofxOilSimulator::beginCanvas() {
+	canvas.begin();
+
+	if (useCanvasBuffer) {
+		if (multisampleCanvas.isAllocated()) {
+			multisampleCanvas.bind();
+		} else {
+			canvas.activateAllDrawBuffers();
+		}
+
+		canvasShader.begin();
+		canvasShader.setUniform1f("minAlpha", (ofxOilTrace::MIN_ALPHA - 0.5) / 255.0);
+		canvasShader.setUniform1f("ribbonMode", 0);
+	}
+}
+
+void ofxOilSimulator::endCanvas() {
+	if (useCanvasBuffer) {
+		canvasShader.end();
+	}
+
+	if (multisampleCanvas.isAllocated()) {
+		multisampleCanvas.unbind();
+		canvas.end();
+		multisampleCanvas.resolve(canvas);
+	} else {
+		canvas.end();
+	}
+}
+
 void ofxOilSimulator::setImage(const ofImage& image, bool clearCanvas) {
 	setImagePixels(image.getPixels(), clearCanvas);
 }
 
+void ofxOilSimulator::setMask(const ofPixels& mask) {
+	// Check that the input makes sense
+	if (!img.isValid()) {
+		throw logic_error("The image should be set before the mask.");
+	} else if (mask.getWidth() != img.getWidth() || mask.getHeight() != img.getHeight()) {
+		throw invalid_argument("The mask dimensions should match the image dimensions.");
+	}
+
+	// Save the first mask channel
+	unsigned int nChannels = mask.getNumChannels();
+	maskPixels.allocate(mask.getWidth(), mask.getHeight(), OF_PIXELS_GRAY);
+
+	for (unsigned int pixel = 0, nPixels = maskPixels.getWidth() * maskPixels.getHeight(); pixel < nPixels; ++pixel) {
+		maskPixels[pixel] = mask[pixel * nChannels] != 0 ? 255 : 0;
+	}
+
+	updateMaskSpans();
+
+	// The error metrics, the bad painted pixels and the convergence window should only consider the masked pixels
+	errorSumsAreValid = false;
+	convergenceWork = 0;
+	convergenceBadPixels = nMaskedPixels;
+
+	// Adapt the initial brush size to the masked area if the painting didn't start yet
+	if (nTraces == 0) {
+		averageBrushSize = max(SMALLER_BRUSH_SIZE, max(maskBounds.getWidth(), maskBounds.getHeight()) / 6.0f);
+		resetFailedStarts();
+	}
+}
+
+void ofxOilSimulator::setMask(const vector<ofRectangle>& regions) {
+	// Check that the input makes sense
+	if (!img.isValid()) {
+		throw logic_error("The image should be set before the mask.");
+	}
+
+	// Fill the mask with the regions
+	int width = img.getWidth();
+	int height = img.getHeight();
+	ofPixels mask;
+	mask.allocate(width, height, OF_PIXELS_GRAY);
+	mask.setColor(ofColor(0));
+
+	for (const ofRectangle& region : regions) {
+		int xMin = max(0, int(floor(region.getLeft())));
+		int xMax = min(width - 1, int(ceil(region.getRight())) - 1);
+		int yMin = max(0, int(floor(region.getTop())));
+		int yMax = min(height - 1, int(ceil(region.getBottom())) - 1);
+
+		for (int y = yMin; y <= yMax; ++y) {
+			for (int x = xMin; x <= xMax; ++x) {
+				mask[y * width + x] = 255;
+			}
+		}
+	}
+
+	setMask(mask);
+}
+
+void ofxOilSimulator::clearMask() {
+	maskPixels.clear();
+
+	if (img.isValid()) {
+		updateMaskSpans();
+		errorSumsAreValid = false;
+		convergenceWork = 0;
+		convergenceBadPixels = nMaskedPixels;
+	}
+}
+
+bool ofxOilSimulator::hasMask() const {
+	return maskPixels.isAllocated();
+}
+
+void ofxOilSimulator::setOutOfCoreStorage(const string& filePrefix) {
+	// Check that the input makes sense
+	if (!filePrefix.empty() && !cpuCanvas) {
+		throw logic_error("The out of core storage can only be used with the CPU canvas.");
+	}
+
+	outOfCorePrefix = filePrefix;
+
+	// Move the pixel arrays to the new storage. They will be filled again in the next update.
+	if (img.isValid()) {
+		allocatePixelArrays(img.getWidth(), img.getHeight());
+		updateMaskSpans();
+		errorSumsAreValid = false;
+	}
+}
+
 void ofxOilSimulator::update(bool stepByStep) {
 	// Don't do anything if the painting is finished
 	if (paintingIsFinised) {
@@ -130,63 +446,527 @@ void ofxOilSimulator::update(bool stepByStep) {
 	}
 }
 
+ofxOilSimulator::StopReason ofxOilSimulator::paintUntil(float targetPsnr, unsigned int maxTraces, float maxSeconds) {
+	// Check that the input makes sense
+	if (targetPsnr < 0 || maxSeconds < 0) {
+		throw invalid_argument("The target PSNR and the maximum time cannot be negative");
+	}
+
+	float startTime = ofGetElapsedTimef();
+	unsigned int startTraces = nTraces;
+	StopReason reason = StopReason::PAINTING_FINISHED;
+
+	// Complete the current trace if it was being painted step by step
+	if (!paintingIsFinised && !obtainNewTrace) {
+		while (traceStep < trace.getNSteps()) {
+			paintTraceStep();
+		}
+
+		obtainNewTrace = true;
+	}
+
+	while (!paintingIsFinised) {
+		// Check the trace and time limits
+		if (maxTraces > 0 && nTraces - startTraces >= maxTraces) {
+			reason = StopReason::MAX_TRACES;
+			break;
+		} else if (maxSeconds > 0 && ofGetElapsedTimef() - startTime >= maxSeconds) {
+			reason = StopReason::DEADLINE;
+			break;
+		}
+
+		// Update the pixel arrays and check the quality limit before a new trace is obtained
+		updatePixelArrays();
+
+		if (targetPsnr > 0 && getPSNR() >= targetPsnr) {
+			reason = StopReason::TARGET_QUALITY;
+			break;
+		}
+
+		// Get a new trace and paint it if the painting is not finished
+		if (!getNewTrace(maxSeconds > 0 ? startTime + maxSeconds : 0)) {
+			reason = StopReason::DEADLINE;
+			break;
+		}
+
+		if (!paintingIsFinised) {
+			paintTrace();
+			obtainNewTrace = true;
+		}
+	}
+
+	if (verbose && reason != StopReason::PAINTING_FINISHED) {
+		ofLogNotice() << "Painting stopped by the " << (reason == StopReason::TARGET_QUALITY ? "quality" :
+				(reason == StopReason::MAX_TRACES ? "traces" : "time")) << " limit: traces = " << nTraces
+				<< ", PSNR = " << getPSNR() << " dB";
+	}
+
+	return reason;
+}
+
+void ofxOilSimulator::allocatePixelArrays(int width, int height) {
+	if (outOfCorePrefix.empty()) {
+		tiledPaintedPixels.reset();
+		tiledSimilarColorPixels.reset();
+		unpaintedPixels = ofxOilBitMask();
+		similarColorPixels.allocate(width, height, OF_PIXELS_GRAY);
+		badPaintedPixels = vector<unsigned int>(width * height);
+	} else {
+		// The painted pixels will be copied from the canvas in the next update. The bad painted pixels list only
+		// grows to the number of bad painted pixels.
+		paintedPixels.clear();
+		similarColorPixels.clear();
+		badPaintedPixels = vector<unsigned int>();
+		unpaintedPixels.allocate(width, height);
+		tiledPaintedPixels.reset(new ofxOilTiledPixels());
+		tiledPaintedPixels->allocate(width, height, 3, outOfCorePrefix + "_painted.bin");
+		tiledSimilarColorPixels.reset(new ofxOilTiledPixels());
+		tiledSimilarColorPixels->allocate(width, height, 1, outOfCorePrefix + "_similar.bin");
+	}
+
+	nBadPaintedPixels = 0;
+	nStartingPixels = 0;
+	paintedPixelsAreOutdated = true;
+}
+
+const unsigned char* ofxOilSimulator::getPaintedPixel(unsigned int x, unsigned int y) const {
+	if (tiledPaintedPixels) {
+		return tiledPaintedPixels->getPixel(x, y);
+	}
+
+	return paintedPixels.getData() + (y * paintedPixels.getWidth() + x) * paintedPixels.getNumChannels();
+}
+
+void ofxOilSimulator::setSimilarColorPixel(unsigned int x, unsigned int y, unsigned char value) {
+	if (tiledSimilarColorPixels) {
+		*tiledSimilarColorPixels->getPixel(x, y) = value;
+	} else {
+		similarColorPixels[y * similarColorPixels.getWidth() + x] = value;
+	}
+}
+
 void ofxOilSimulator::updatePixelArrays() {
 	// Update the visited pixels array
 	updateVisitedPixels();
 
-	// Update the painted pixels array
-	if (useCanvasBuffer) {
-		canvasBuffer.readToPixels(paintedPixels);
-	} else {
-		canvas.readToPixels(paintedPixels);
+	// Update the painted pixels array and the error metric. All the pixel arrays should be updated if the error sums
+	// are not valid.
+	bool updateAllPixels = !errorSumsAreValid;
+	ofRectangle changedRegion = dirtyRegion;
+	updatePaintedPixels();
+
+	// Update the similar color pixels and the bad painted pixels arrays
+	unsigned int width = img.getWidth();
+
+	if (!tiledPaintedPixels || updateAllPixels) {
+		nBadPaintedPixels = 0;
+
+		if (tiledPaintedPixels) {
+			badPaintedPixels.clear();
+			unpaintedPixels.clear();
+		}
+
+		for (const array<unsigned int, 3>& span : maskSpans) {
+			for (unsigned int x = span[1]; x <= span[2]; ++x) {
+				updateBadPaintedPixel(x, span[0]);
+			}
+		}
+	} else if (!changedRegion.isEmpty()) {
+		// Only the pixels painted since the last update should be checked again when they are stored out of core
+		int xMin = max(0, int(floor(changedRegion.getLeft())));
+		int xMax = min(int(width) - 1, int(ceil(changedRegion.getRight())));
+		int yMin = max(0, int(floor(changedRegion.getTop())));
+		int yMax = min(int(img.getHeight()) - 1, int(ceil(changedRegion.getBottom())));
+
+		if (xMin <= xMax && yMin <= yMax) {
+			// Remove the region pixels from the bad painted pixels list
+			badPaintedPixels.erase(remove_if(badPaintedPixels.begin(), badPaintedPixels.end(),
+					[width, xMin, xMax, yMin, yMax](unsigned int pixel) {
+						int x = pixel % width;
+						int y = pixel / width;
+						return x >= xMin && x <= xMax && y >= yMin && y <= yMax;
+					}), badPaintedPixels.end());
+
+			// Check again the masked pixels inside the region
+			auto span = lower_bound(maskSpans.begin(), maskSpans.end(), unsigned(yMin),
+					[](const array<unsigned int, 3>& s, unsigned int y) {return s[0] < y;});
+
+			for (; span != maskSpans.end() && int((*span)[0]) <= yMax; ++span) {
+				for (int x = max(int((*span)[1]), xMin), xEnd = min(int((*span)[2]), xMax); x <= xEnd; ++x) {
+					updateBadPaintedPixel(x, (*span)[0]);
+				}
+			}
+		}
+	}
+
+	if (tiledPaintedPixels) {
+		nBadPaintedPixels = badPaintedPixels.size();
+	}
+
+	// Move the bad painted pixels that should not be used as starting pixels to the end of the list
+	nStartingPixels = partition(badPaintedPixels.begin(), badPaintedPixels.begin() + nBadPaintedPixels,
+			[this](unsigned int pixel) {return !isDiscardedStartingPixel(pixel);}) - badPaintedPixels.begin();
+}
+
+void ofxOilSimulator::updateBadPaintedPixel(unsigned int x, unsigned int y) {
+	// Check if the pixel is well painted
+	const unsigned char* paintedPixel = getPaintedPixel(x, y);
+	ofColor imgColor = img.getColor(x, y);
+
+	if (paintedPixel[0] != BACKGROUND_COLOR.r && paintedPixel[1] != BACKGROUND_COLOR.g
+			&& paintedPixel[2] != BACKGROUND_COLOR.b
+			&& abs(imgColor.r - paintedPixel[0]) < MAX_COLOR_DIFFERENCE[0]
+			&& abs(imgColor.g - paintedPixel[1]) < MAX_COLOR_DIFFERENCE[1]
+			&& abs(imgColor.b - paintedPixel[2]) < MAX_COLOR_DIFFERENCE[2]) {
+		setSimilarColorPixel(x, y, 0);
+		return;
+	}
+
+	// Add the pixel to the bad painted pixels list
+	setSimilarColorPixel(x, y, 255);
+	unsigned int pixel = y * img.getWidth() + x;
+
+	if (tiledPaintedPixels) {
+		badPaintedPixels.push_back(pixel);
+
+		// Keep track of the unpainted pixels, so the painted pixels file is not read when the list is partitioned
+		if (paintedPixel[0] == BACKGROUND_COLOR.r && paintedPixel[1] == BACKGROUND_COLOR.g
+				&& paintedPixel[2] == BACKGROUND_COLOR.b) {
+			unpaintedPixels.set(x, y);
+		} else {
+			unpaintedPixels.reset(x, y);
+		}
+	} else {
+		badPaintedPixels[nBadPaintedPixels] = pixel;
+		++nBadPaintedPixels;
+	}
+}
+
+void ofxOilSimulator::updatePaintedPixels() {
+	if (cpuCanvas) {
+		// Copy only the region painted since the last update, unless the painted pixels are not valid anymore
+		const ofPixels& source = useCanvasBuffer ? canvasBufferPixels : canvasPixels;
+		ofRectangle changedRegion = dirtyRegion;
+		dirtyRegion = ofRectangle();
+
+		// The pixels outside the mask bounds are only copied if they are outdated
+		ofRectangle copyRegion = errorSumsAreValid ? changedRegion : getPaintedPixelsRefreshRegion();
+
+		if (!copyRegion.isEmpty()) {
+			updateErrorSums(changedRegion, -1);
+
+			if (tiledPaintedPixels) {
+				int xMin = max(0, int(floor(copyRegion.getLeft())));
+				int xMax = min(int(source.getWidth()) - 1, int(ceil(copyRegion.getRight())));
+				int yMin = max(0, int(floor(copyRegion.getTop())));
+				int yMax = min(int(source.getHeight()) - 1, int(ceil(copyRegion.getBottom())));
+
+				if (xMin <= xMax && yMin <= yMax) {
+					tiledPaintedPixels->copyRegion(source, xMin, yMin, xMax - xMin + 1, yMax - yMin + 1);
+				}
+			} else {
+				copyToPaintedPixels(source.getData(), source.getBytesStride(), copyRegion);
+			}
+
+			updateErrorSums(changedRegion, 1);
+		}
+	} else if (asyncReadback) {
+		updatePaintedPixelsAsync();
+	} else {
+		// Read only the region painted since the last update inside the mask bounds, unless the painted pixels
+		// should be refreshed
+		ofRectangle changedRegion = dirtyRegion;
+		dirtyRegion = ofRectangle();
+		ofRectangle readRegion = errorSumsAreValid ? maskBounds : getPaintedPixelsRefreshRegion();
+
+		if (errorSumsAreValid) {
+			float xMin = max(changedRegion.getLeft(), readRegion.getLeft());
+			float xMax = min(changedRegion.getRight(), readRegion.getRight());
+			float yMin = max(changedRegion.getTop(), readRegion.getTop());
+			float yMax = min(changedRegion.getBottom(), readRegion.getBottom());
+			readRegion = xMin < xMax && yMin < yMax ?
+					ofRectangle(xMin, yMin, xMax - xMin, yMax - yMin) : ofRectangle();
+		}
+
+		updateErrorSums(changedRegion, -1);
+		readCanvasRegion(readRegion);
+		updateErrorSums(changedRegion, 1);
+	}
+
+	// Log the painting quality if necessary
+	if (logPaintingQuality) {
+		qualityCurve.push_back( { ofGetElapsedTimef() - paintingStartTime, nTraces, getPSNR() });
+	}
+}
+
+void ofxOilSimulator::updatePaintedPixelsAsync() {
+#ifndef TARGET_OPENGLES
+	// Getting the texture resolves the multisampled canvas. The buffer rows are packed with 4 bytes alignment.
+	const ofTexture& texture = canvas.getTexture(useCanvasBuffer ? 1 : 0);
+	int width = texture.getWidth();
+	int height = texture.getHeight();
+	int stride = ((3 * width + 3) / 4) * 4;
+
+	// Allocate the ring buffers if necessary
+	if (readbackBuffers.size() != max(READBACK_BUFFERS, 1u)) {
+		readbackBuffers = vector<ofBufferObject>(max(READBACK_BUFFERS, 1u));
+		readbackRegions = vector<ofRectangle>(readbackBuffers.size());
+		readbackCopyRegions = vector<ofRectangle>(readbackBuffers.size());
+		nReadbacks = 0;
+		nConsumedReadbacks = 0;
+
+		for (ofBufferObject& buffer : readbackBuffers) {
+			buffer.allocate(stride * height, GL_STREAM_READ);
+		}
+	}
+
+	// Use the new transfer directly if the painted pixels should be refreshed, since the older transfers might not
+	// contain the new mask bounds
+	if (!errorSumsAreValid) {
+		nReadbacks = 0;
+		nConsumedReadbacks = 0;
+	}
+
+	// Start the transfer of the current canvas pixels inside the mask bounds. The buffer rows have the same layout
+	// as the texture rows.
+	unsigned int nBuffers = readbackBuffers.size();
+	unsigned int writeIndex = nReadbacks % nBuffers;
+	ofRectangle copyRegion = errorSumsAreValid ? maskBounds : getPaintedPixelsRefreshRegion();
+	int xMin = max(0, int(floor(copyRegion.getLeft())));
+	int xMax = min(width - 1, int(ceil(copyRegion.getRight())));
+	int yMin = max(0, int(floor(copyRegion.getTop())));
+	int yMax = min(height - 1, int(ceil(copyRegion.getBottom())));
+
+	if (xMin <= xMax && yMin <= yMax) {
+		GLint previousFramebuffer;
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, canvas.getIdDrawBuffer());
+		glReadBuffer(GL_COLOR_ATTACHMENT0 + (useCanvasBuffer ? 1 : 0));
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glPixelStorei(GL_PACK_ROW_LENGTH, width);
+		readbackBuffers[writeIndex].bind(GL_PIXEL_PACK_BUFFER);
+		glReadPixels(xMin, yMin, xMax - xMin + 1, yMax - yMin + 1, GL_RGB, GL_UNSIGNED_BYTE,
+				reinterpret_cast<void*>(size_t(yMin * stride + 3 * xMin)));
+		readbackBuffers[writeIndex].unbind(GL_PIXEL_PACK_BUFFER);
+		glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+	}
+
+	readbackRegions[writeIndex] = dirtyRegion;
+	readbackCopyRegions[writeIndex] = copyRegion;
+	dirtyRegion = ofRectangle();
+	++nReadbacks;
+
+	// Use the transfer started nBuffers - 1 calls before. The first transfer is used until then.
+	unsigned int readback = nReadbacks >= nBuffers ? nReadbacks - nBuffers + 1 : 1;
+
+	if (readback != nConsumedReadbacks) {
+		// Calculate the region painted since the last used transfer
+		ofRectangle changedRegion;
+
+		for (unsigned int i = nConsumedReadbacks + 1; i <= readback; ++i) {
+			growRegion(changedRegion, readbackRegions[(i - 1) % nBuffers]);
+		}
+
+		// Update the painted pixels and the error sums
+		ofBufferObject& readBuffer = readbackBuffers[(readback - 1) % nBuffers];
+		updateErrorSums(changedRegion, -1);
+		const unsigned char* data = readBuffer.map<unsigned char>(GL_READ_ONLY);
+		copyToPaintedPixels(data, stride, readbackCopyRegions[(readback - 1) % nBuffers]);
+		readBuffer.unmap();
+		updateErrorSums(changedRegion, 1);
+		nConsumedReadbacks = readback;
+	}
+#endif
+}
+
+ofRectangle ofxOilSimulator::getPaintedPixelsRefreshRegion() {
+	if (paintedPixelsAreOutdated) {
+		paintedPixelsAreOutdated = false;
+		return ofRectangle(0, 0, img.getWidth(), img.getHeight());
+	}
+
+	return maskBounds;
+}
+
+void ofxOilSimulator::copyToPaintedPixels(const unsigned char* data, size_t stride, const ofRectangle& region) {
+	// Allocate the painted pixels if necessary
+	int width = img.getWidth();
+	int height = img.getHeight();
+
+	if (int(paintedPixels.getWidth()) != width || int(paintedPixels.getHeight()) != height
+			|| paintedPixels.getNumChannels() != 3) {
+		paintedPixels.allocate(width, height, OF_PIXELS_RGB);
+		paintedPixels.setColor(BACKGROUND_COLOR);
+	}
+
+	// Copy the region rows
+	int xMin = max(0, int(floor(region.getLeft())));
+	int xMax = min(width - 1, int(ceil(region.getRight())));
+	int yMin = max(0, int(floor(region.getTop())));
+	int yMax = min(height - 1, int(ceil(region.getBottom())));
+
+	for (int y = yMin; y <= yMax && xMin <= xMax; ++y) {
+		memcpy(paintedPixels.getData() + 3 * (y * width + xMin), data + y * stride + 3 * xMin, 3 * (xMax - xMin + 1));
+	}
+}
+
+void ofxOilSimulator::readCanvasRegion(const ofRectangle& region) {
+	if (region.isEmpty()) {
+		return;
+	}
+
+#ifdef TARGET_OPENGLES
+	// Sub-region reads need GL_PACK_ROW_LENGTH, which is not available in OpenGL ES 2
+	canvas.readToPixels(paintedPixels, useCanvasBuffer ? 1 : 0);
+#else
+	// Allocate the painted pixels if necessary
+	int width = img.getWidth();
+	int height = img.getHeight();
+
+	if (int(paintedPixels.getWidth()) != width || int(paintedPixels.getHeight()) != height
+			|| paintedPixels.getNumChannels() != 3) {
+		paintedPixels.allocate(width, height, OF_PIXELS_RGB);
+		paintedPixels.setColor(BACKGROUND_COLOR);
+	}
+
+	int xMin = max(0, int(floor(region.getLeft())));
+	int xMax = min(width - 1, int(ceil(region.getRight())));
+	int yMin = max(0, int(floor(region.getTop())));
+	int yMax = min(height - 1, int(ceil(region.getBottom())));
+
+	if (xMin > xMax || yMin > yMax) {
+		return;
+	}
+
+	// Read the region directly into the painted pixels. Getting the texture resolves the multisampled canvas.
+	int attachment = useCanvasBuffer ? 1 : 0;
+	canvas.getTexture(attachment);
+	GLint previousFramebuffer;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, canvas.getIdDrawBuffer());
+	glReadBuffer(GL_COLOR_ATTACHMENT0 + attachment);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_PACK_ROW_LENGTH, width);
+	glReadPixels(xMin, yMin, xMax - xMin + 1, yMax - yMin + 1, GL_RGB, GL_UNSIGNED_BYTE,
+			paintedPixels.getData() + 3 * (yMin * width + xMin));
+	glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+#endif
+}
+
+void ofxOilSimulator::updateErrorSums(const ofRectangle& region, int sign) {
+	// Check if the error sums should be calculated from scratch
+	bool fromScratch = !errorSumsAreValid;
+
+	if (fromScratch) {
+		if (sign < 0) {
+			return;
+		}
+
+		absErrorSums = { 0, 0, 0 };
+		sqErrorSums = { 0, 0, 0 };
+		errorSumsAreValid = true;
+	} else if (region.isEmpty()) {
+		return;
+	}
+
+	// Add the pixels contribution to the error sums
+	array<int64_t, 3> absSums = { 0, 0, 0 };
+	array<int64_t, 3> sqSums = { 0, 0, 0 };
+	auto addPixel = [this, &absSums, &sqSums](int x, int y) {
+		const unsigned char* paintedPixel = getPaintedPixel(x, y);
+		ofColor imgColor = img.getColor(x, y);
+
+		for (unsigned int c = 0; c < 3; ++c) {
+			int diff = imgColor[c] - paintedPixel[c];
+			absSums[c] += abs(diff);
+			sqSums[c] += diff * diff;
+		}
+	};
+
+	if (fromScratch) {
+		// Only the masked pixels contribute to the error sums
+		for (const array<unsigned int, 3>& span : maskSpans) {
+			for (unsigned int x = span[1]; x <= span[2]; ++x) {
+				addPixel(x, span[0]);
+			}
+		}
+	} else {
+		int xMin = max(0, int(floor(region.getLeft())));
+		int xMax = min(int(img.getWidth()) - 1, int(ceil(region.getRight())));
+		int yMin = max(0, int(floor(region.getTop())));
+		int yMax = min(int(img.getHeight()) - 1, int(ceil(region.getBottom())));
+
+		for (int y = yMin; y <= yMax; ++y) {
+			for (int x = xMin; x <= xMax; ++x) {
+				if (isMaskedPixel(x, y)) {
+					addPixel(x, y);
+				}
+			}
+		}
+	}
+
+	for (unsigned int c = 0; c < 3; ++c) {
+		absErrorSums[c] += sign * absSums[c];
+		sqErrorSums[c] += sign * sqSums[c];
+	}
+}
+
+ofRectangle ofxOilSimulator::getTraceRegion() const {
+	// Calculate the bounding box of the bristle positions along the trace trajectory
+	float xMin = numeric_limits<float>::max();
+	float xMax = numeric_limits<float>::lowest();
+	float yMin = numeric_limits<float>::max();
+	float yMax = numeric_limits<float>::lowest();
+
+	for (unsigned int i = trace.getFirstBristleStep(), nSteps = trace.getNSteps(); i < nSteps; ++i) {
+		for (const glm::vec2& pos : trace.getBristlePositions(i)) {
+			xMin = min(xMin, pos.x);
+			xMax = max(xMax, pos.x);
+			yMin = min(yMin, pos.y);
+			yMax = max(yMax, pos.y);
+		}
+	}
+
+	if (xMin > xMax) {
+		return ofRectangle();
 	}
 
-	// Update the similar color pixels and the bad painted pixels arrays
-	const ofPixels& imgPixels = img.getPixels();
-	unsigned int imgNumChannels = imgPixels.getNumChannels();
-	unsigned int canvasNumChannels = paintedPixels.getNumChannels();
-	nBadPaintedPixels = 0;
+	// Add some margin for the bristles elements
+	float margin = ofxOilBrush::MAX_BRISTLE_LENGTH + ofxOilBrush::MAX_BRISTLE_THICKNESS + 1;
+	return ofRectangle(xMin - margin, yMin - margin, xMax - xMin + 2 * margin, yMax - yMin + 2 * margin);
+}
 
-	for (unsigned int pixel = 0, nPixels = img.getWidth() * img.getHeight(); pixel < nPixels; ++pixel) {
-		unsigned int imgPix = pixel * imgNumChannels;
-		unsigned int canvasPix = pixel * canvasNumChannels;
-
-		// Check if the pixel is well painted
-		if (paintedPixels[canvasPix] != BACKGROUND_COLOR.r && paintedPixels[canvasPix + 1] != BACKGROUND_COLOR.g
-				&& paintedPixels[canvasPix + 2] != BACKGROUND_COLOR.b
-				&& abs(imgPixels[imgPix] - paintedPixels[canvasPix]) < MAX_COLOR_DIFFERENCE[0]
-				&& abs(imgPixels[imgPix + 1] - paintedPixels[canvasPix + 1]) < MAX_COLOR_DIFFERENCE[1]
-				&& abs(imgPixels[imgPix + 2] - paintedPixels[canvasPix + 2]) < MAX_COLOR_DIFFERENCE[2]) {
-			similarColorPixels[pixel] = 0;
-		} else {
-			similarColorPixels[pixel] = 255;
-			badPaintedPixels[nBadPaintedPixels] = pixel;
-			++nBadPaintedPixels;
-		}
+void ofxOilSimulator::growRegion(ofRectangle& region, const ofRectangle& newRegion) {
+	if (region.isEmpty()) {
+		region = newRegion;
+	} else if (!newRegion.isEmpty()) {
+		region.growToInclude(newRegion);
 	}
 }
 
 void ofxOilSimulator::updateVisitedPixels() {
 	// Check if we are at the beginning of a simulation
 	if (nTraces == 0) {
-		// Reset the visited pixels array
-		visitedPixels.setColor(255);
+		// Reset the visited pixels mask
+		visitedPixels.clear();
 	} else {
-		// Update the visited pixels arrays with the trace bristle positions
+		// Update the visited pixels mask with the trace bristle positions
 		const vector<unsigned char>& alphas = trace.getTrajectoryAphas();
-		const vector<vector<glm::vec2>>& bristlePositions = trace.getBristlePositions();
 		int width = visitedPixels.getWidth();
 		int height = visitedPixels.getHeight();
 
-		for (unsigned int i = 0, nSteps = trace.getNSteps(); i < nSteps; ++i) {
-			// Fill the visited pixels array if alpha is high enough
+		for (unsigned int i = trace.getFirstBristleStep(), nSteps = trace.getNSteps(); i < nSteps; ++i) {
+			// Fill the visited pixels mask if alpha is high enough
 			if (alphas[i] >= ofxOilTrace::MIN_ALPHA) {
-				for (const glm::vec2& pos : bristlePositions[i]) {
+				for (const glm::vec2& pos : trace.getBristlePositions(i)) {
 					int x = pos.x;
 					int y = pos.y;
 
 					if (x >= 0 && x < width && y >= 0 && y < height) {
-						visitedPixels.setColor(x, y, 0);
+						visitedPixels.set(x, y);
 					}
 				}
 			}
@@ -194,16 +974,19 @@ void ofxOilSimulator::updateVisitedPixels() {
 	}
 }
 
-void ofxOilSimulator::getNewTrace() {
-	// Loop until a new trace is found or the painting is finished
+bool ofxOilSimulator::getNewTrace(float deadline) {
+	// Loop until a new trace is found, the painting is finished or the deadline is reached
 	unsigned int invalidTrajectoriesCounter = 0;
 	unsigned int invalidTracesCounter = 0;
 	int imgWidth = img.getWidth();
 
 	while (true) {
+		// Check if the painting doesn't improve enough anymore with the current brush size
+		bool converged = hasConverged();
+
 		// Check if we should stop the painting simulation
 		if (averageBrushSize == SMALLER_BRUSH_SIZE
-				&& (invalidTrajectoriesCounter > MAX_INVALID_TRAJECTORIES_FOR_SMALLER_SIZE
+				&& (converged || invalidTrajectoriesCounter > MAX_INVALID_TRAJECTORIES_FOR_SMALLER_SIZE
 						|| invalidTracesCounter > MAX_INVALID_TRACES_FOR_SMALLER_SIZE)) {
 			// Print some debug information if necessary
 			if (verbose) {
@@ -213,11 +996,11 @@ void ofxOilSimulator::getNewTrace() {
 
 			// Stop the painting
 			paintingIsFinised = true;
-			break;
+			return true;
 		} else {
 			// Change the average brush size if there were too many invalid traces
 			if (averageBrushSize > SMALLER_BRUSH_SIZE
-					&& (invalidTrajectoriesCounter > MAX_INVALID_TRAJECTORIES
+					&& (converged || invalidTrajectoriesCounter > MAX_INVALID_TRAJECTORIES
 							|| invalidTracesCounter > MAX_INVALID_TRACES)) {
 				// Decrease the brush size
 				averageBrushSize = max(SMALLER_BRUSH_SIZE,
@@ -233,49 +1016,158 @@ void ofxOilSimulator::getNewTrace() {
 				invalidTrajectoriesCounter = 0;
 				invalidTracesCounter = 0;
 
-				// Reset the visited pixels array
-				visitedPixels.setColor(255);
+				// Reset the visited pixels mask
+				visitedPixels.clear();
+
+				// All the bad painted pixels can be used again as starting pixels
+				resetFailedStarts();
+				nStartingPixels = nBadPaintedPixels;
+
+				// Start a new convergence window
+				resetConvergenceWindow();
 			}
 
-			// Create new traces until one of them has a valid trajectory or we exceed a number of tries
-			bool isValidTrajectory = false;
-			float brushSize = max(SMALLER_BRUSH_SIZE, averageBrushSize * ofRandom(0.95, 1.05));
-			int nSteps = max(MIN_TRACE_LENGTH, RELATIVE_TRACE_LENGTH * brushSize * ofRandom(0.9, 1.1)) / TRACE_SPEED;
+			// Create new traces until enough of them have a valid trajectory or we exceed a number of tries
+			float brushSize = max(SMALLER_BRUSH_SIZE, averageBrushSize * ofxOilRandom(0.95, 1.05));
+			int nSteps = max(MIN_TRACE_LENGTH, RELATIVE_TRACE_LENGTH * brushSize * ofxOilRandom(0.9, 1.1))
+					/ TRACE_SPEED;
+			unsigned int nCandidates = max(CANDIDATE_TRACES, 1u);
+			vector<ofxOilTrace> candidates;
+			vector<unsigned int> candidatePixels;
+
+			while (candidates.size() < nCandidates && invalidTrajectoriesCounter % 500 != 499) {
+				// Stop searching if the deadline has been reached
+				if (deadline > 0 && ofGetElapsedTimef() >= deadline) {
+					return false;
+				}
 
-			while (!isValidTrajectory && invalidTrajectoriesCounter % 500 != 499) {
-				// Create the trace starting from a bad painted pixel
-				unsigned int pixel = badPaintedPixels[floor(ofRandom(nBadPaintedPixels))];
-				glm::vec2 startingPosition = glm::vec2(pixel % imgWidth, pixel / imgWidth);
-				trace = ofxOilTrace(startingPosition, nSteps, TRACE_SPEED);
+				// Move to the next brush size if there are no starting pixels left
+				if (nStartingPixels == 0) {
+					invalidTrajectoriesCounter = max(MAX_INVALID_TRAJECTORIES,
+							MAX_INVALID_TRAJECTORIES_FOR_SMALLER_SIZE) + 1;
+					break;
+				}
+
+				// Select a bad painted pixel, preferring the high detail regions for the small brushes
+				unsigned int index = floor(ofxOilRandom(nStartingPixels));
+
+				if (averageBrushSize < DETAIL_BRUSH_SIZE) {
+					for (unsigned int i = 1; i < DETAIL_SAMPLING_CHOICES; ++i) {
+						unsigned int otherIndex = floor(ofxOilRandom(nStartingPixels));
+
+						if (getPixelDetail(badPaintedPixels[otherIndex]) > getPixelDetail(badPaintedPixels[index])) {
+							index = otherIndex;
+						}
+					}
+				}
+
+				unsigned int pixel = badPaintedPixels[index];
 
-				// Check if the trace has a valid trajectory
-				isValidTrajectory = !alreadyVisitedTrajectory() && validTrajectory();
+				// Remove the pixel from the starting pixels if too many traces failed around it
+				if (isDiscardedStartingPixel(pixel)) {
+					swap(badPaintedPixels[index], badPaintedPixels[nStartingPixels - 1]);
+					--nStartingPixels;
+					continue;
+				}
+
+				// Create the trace starting from the bad painted pixel
+				glm::vec2 startingPosition = glm::vec2(pixel % imgWidth, pixel / imgWidth);
+				ofxOilTrace candidate = flowField.isAllocated() ?
+						ofxOilTrace(startingPosition, nSteps, TRACE_SPEED, flowField) :
+						ofxOilTrace(startingPosition, nSteps, TRACE_SPEED);
+
+				// Keep the trace if it has a valid trajectory
+				if (!alreadyVisitedTrajectory(candidate) && validTrajectory(candidate)) {
+					candidate.setBrushSize(brushSize);
+					candidates.push_back(move(candidate));
+					candidatePixels.push_back(pixel);
+				} else {
+					addFailedStart(pixel);
+				}
 
-				// Increase the counter
+				// Increase the counters
 				++invalidTrajectoriesCounter;
+				++convergenceWork;
 			}
 
-			// Check if we have a valid trajectory
-			if (isValidTrajectory) {
+			// Check if we have at least one valid trajectory
+			if (candidates.size() > 0) {
 				// Reset the invalid trajectories counter
 				invalidTrajectoriesCounter = 0;
 
-				// Set the trace brush size
-				trace.setBrushSize(brushSize);
+				// Calculate the traces colors and check if painting them will improve the painting. The first trace
+				// is evaluated in this thread and the rest in the shared worker pool, unless the painted pixels are
+				// stored out of core, since the tiled containers cannot be shared between threads, or this thread is
+				// already a pool worker.
+				vector<float> errorReductions(candidates.size());
+				vector<char> improvesPainting(candidates.size());
+				auto evaluateCandidate = [&](unsigned int c) {
+					if (tiledPaintedPixels) {
+						candidates[c].gatherBristleColors(img, *tiledPaintedPixels, BACKGROUND_COLOR);
+					} else {
+						candidates[c].gatherBristleColors(img, paintedPixels, BACKGROUND_COLOR);
+					}
+
+					candidates[c].calculateAverageColor(img);
+					candidates[c].calculateBristleColors(paintedPixels, BACKGROUND_COLOR);
+					improvesPainting[c] = traceImprovesPainting(candidates[c], errorReductions[c]);
+				};
+
+				bool evaluateSerially = tiledPaintedPixels || ofxOilWorkerPool::isWorkerThread();
+				vector<future<void>> evaluations;
+				exception_ptr evaluationError;
+
+				try {
+					for (unsigned int c = 1; c < candidates.size(); ++c) {
+						if (evaluateSerially) {
+							evaluateCandidate(c);
+						} else {
+							evaluations.push_back(ofxOilWorkerPool::getShared().submit([&evaluateCandidate, c]() {
+								evaluateCandidate(c);
+							}));
+						}
+					}
+
+					evaluateCandidate(0);
+				} catch (...) {
+					evaluationError = current_exception();
+				}
+
+				// Wait for all the submitted evaluations before rethrowing any error, since they use the local
+				// variables
+				for (future<void>& evaluation : evaluations) {
+					evaluation.wait();
+				}
+
+				if (evaluationError) {
+					rethrow_exception(evaluationError);
+				}
 
-				// Calculate the trace average color and the bristle colors along the trajectory
-				trace.calculateAverageColor(img);
-				trace.calculateBristleColors(paintedPixels, BACKGROUND_COLOR);
+				for (future<void>& evaluation : evaluations) {
+					evaluation.get();
+				}
+
+				// Select the trace with the largest error reduction
+				int bestCandidate = -1;
+
+				for (unsigned int c = 0; c < candidates.size(); ++c) {
+					if (!improvesPainting[c]) {
+						addFailedStart(candidatePixels[c]);
+					} else if (bestCandidate < 0 || errorReductions[c] > errorReductions[bestCandidate]) {
+						bestCandidate = c;
+					}
+				}
 
-				// Check if painting the trace will improve the painting
-				if (traceImprovesPainting()) {
+				if (bestCandidate >= 0) {
 					// Test passed, the trace is good enough to be painted
+					trace = move(candidates[bestCandidate]);
+					growRegion(dirtyRegion, getTraceRegion());
 					obtainNewTrace = false;
 					traceStep = 0;
 					++nTraces;
-					break;
+					return true;
 				} else {
-					// The trace is not good enough, try again in the next loop step
+					// The traces are not good enough, try again in the next loop step
 					++invalidTracesCounter;
 				}
 			} else {
@@ -286,10 +1178,188 @@ void ofxOilSimulator::getNewTrace() {
 	}
 }
 
-bool ofxOilSimulator::alreadyVisitedTrajectory() const {
+bool ofxOilSimulator::hasConverged() {
+	// Check that we have enough statistics
+	if (MIN_BAD_PAINTED_REDUCTION_RATE <= 0 || convergenceWork < CONVERGENCE_WINDOW) {
+		return false;
+	}
+
+	// Calculate the bad painted pixels reduction rate in the last window
+	float reductionRate = (float(convergenceBadPixels) - float(nBadPaintedPixels)) / convergenceWork;
+	resetConvergenceWindow();
+
+	// Print some debug information if necessary
+	if (verbose && reductionRate < MIN_BAD_PAINTED_REDUCTION_RATE) {
+		ofLogNotice() << "Bad painted pixels reduction rate = " << reductionRate << " pixels/candidate";
+	}
+
+	return reductionRate < MIN_BAD_PAINTED_REDUCTION_RATE;
+}
+
+void ofxOilSimulator::resetConvergenceWindow() {
+	convergenceWork = 0;
+	convergenceBadPixels = nBadPaintedPixels;
+}
+
+void ofxOilSimulator::resetFailedStarts() {
+	// Check that the input makes sense
+	if (MAX_FAILED_STARTS_PER_REGION > numeric_limits<unsigned char>::max()) {
+		throw invalid_argument("The maximum number of failed starts per region cannot be higher than 255.");
+	}
+
+	int imgWidth = img.getWidth();
+	int imgHeight = img.getHeight();
+	failedStartsRegionSize = max(1.0f, RELATIVE_FAILED_STARTS_REGION_SIZE * averageBrushSize);
+	failedStartsRegionsPerRow = (imgWidth + failedStartsRegionSize - 1) / failedStartsRegionSize;
+	unsigned int regionsPerColumn = (imgHeight + failedStartsRegionSize - 1) / failedStartsRegionSize;
+	failedStarts.assign(failedStartsRegionsPerRow * regionsPerColumn, 0);
+}
+
+void ofxOilSimulator::addFailedStart(unsigned int pixel) {
+	if (MAX_FAILED_STARTS_PER_REGION > 0) {
+		unsigned int imgWidth = img.getWidth();
+		unsigned int region = (pixel / imgWidth / failedStartsRegionSize) * failedStartsRegionsPerRow
+				+ (pixel % imgWidth) / failedStartsRegionSize;
+
+		if (failedStarts[region] < MAX_FAILED_STARTS_PER_REGION) {
+			++failedStarts[region];
+		}
+	}
+}
+
+bool ofxOilSimulator::isDiscardedStartingPixel(unsigned int pixel) const {
+	if (isLowDetailPixel(pixel)) {
+		return true;
+	} else if (MAX_FAILED_STARTS_PER_REGION == 0) {
+		return false;
+	}
+
+	unsigned int imgWidth = img.getWidth();
+	unsigned int region = (pixel / imgWidth / failedStartsRegionSize) * failedStartsRegionsPerRow
+			+ (pixel % imgWidth) / failedStartsRegionSize;
+	return failedStarts[region] >= MAX_FAILED_STARTS_PER_REGION;
+}
+
+void ofxOilSimulator::updateMaskSpans() {
+	// Split the masked pixels in horizontal runs
+	unsigned int width = img.getWidth();
+	unsigned int height = img.getHeight();
+	unsigned int xMin = width;
+	unsigned int xMax = 0;
+	unsigned int yMin = height;
+	unsigned int yMax = 0;
+	maskSpans.clear();
+	nMaskedPixels = 0;
+
+	for (unsigned int y = 0; y < height; ++y) {
+		unsigned int x = 0;
+
+		while (x < width) {
+			// Find the next run of masked pixels in the row
+			while (x < width && !isMaskedPixel(x, y)) {
+				++x;
+			}
+
+			if (x == width) {
+				break;
+			}
+
+			unsigned int xStart = x;
+
+			while (x < width && isMaskedPixel(x, y)) {
+				++x;
+			}
+
+			maskSpans.push_back( { y, xStart, x - 1 });
+			nMaskedPixels += x - xStart;
+			xMin = min(xMin, xStart);
+			xMax = max(xMax, x - 1);
+			yMin = min(yMin, y);
+			yMax = max(yMax, y);
+		}
+	}
+
+	maskBounds = nMaskedPixels > 0 ? ofRectangle(xMin, yMin, xMax - xMin + 1, yMax - yMin + 1) : ofRectangle();
+
+	// The pixels outside the mask are never considered bad painted
+	if (tiledSimilarColorPixels) {
+		tiledSimilarColorPixels->setColor(ofColor(0));
+	} else if (similarColorPixels.isAllocated()) {
+		similarColorPixels.setColor(ofColor(0));
+	}
+}
+
+bool ofxOilSimulator::isMaskedPixel(unsigned int x, unsigned int y) const {
+	return !maskPixels.isAllocated() || maskPixels[y * maskPixels.getWidth() + x] != 0;
+}
+
+void ofxOilSimulator::updateDetailMap() {
+	// Initialize the detail map
+	unsigned int width = img.getWidth();
+	unsigned int height = img.getHeight();
+	detailBlockSize = max(DETAIL_BLOCK_SIZE, 1u);
+	detailBlocksPerRow = (width + detailBlockSize - 1) / detailBlockSize;
+	unsigned int blocksPerColumn = (height + detailBlockSize - 1) / detailBlockSize;
+	detailMap.assign(detailBlocksPerRow * blocksPerColumn, 0);
+
+	// Calculate the image luminance
+	vector<unsigned char> luminance(width * height);
+
+	for (unsigned int y = 0, pixel = 0; y < height; ++y) {
+		for (unsigned int x = 0; x < width; ++x, ++pixel) {
+			ofColor color = img.getColor(x, y);
+			luminance[pixel] = (77 * color.r + 150 * color.g + 29 * color.b) >> 8;
+		}
+	}
+
+	// Save the maximum luminance gradient inside each block
+	for (unsigned int y = 1; y + 1 < height; ++y) {
+		unsigned char* blockRow = &detailMap[(y / detailBlockSize) * detailBlocksPerRow];
+
+		for (unsigned int x = 1, pixel = y * width + 1; x + 1 < width; ++x, ++pixel) {
+			int gradient = (abs(luminance[pixel + 1] - luminance[pixel - 1])
+					+ abs(luminance[pixel + width] - luminance[pixel - width])) / 2;
+			unsigned char& detail = blockRow[x / detailBlockSize];
+			detail = max(int(detail), gradient);
+		}
+	}
+}
+
+void ofxOilSimulator::updateFlowField() {
+	if (USE_FLOW_FIELD) {
+		flowField.update(img);
+	} else {
+		flowField.clear();
+	}
+}
+
+unsigned char ofxOilSimulator::getPixelDetail(unsigned int pixel) const {
+	unsigned int imgWidth = img.getWidth();
+	return detailMap[(pixel / imgWidth / detailBlockSize) * detailBlocksPerRow
+			+ (pixel % imgWidth) / detailBlockSize];
+}
+
+bool ofxOilSimulator::isLowDetailPixel(unsigned int pixel) const {
+	if (MIN_DETAIL == 0 || averageBrushSize >= DETAIL_BRUSH_SIZE || getPixelDetail(pixel) >= MIN_DETAIL) {
+		return false;
+	}
+
+	// The unpainted pixels are never skipped
+	unsigned int imgWidth = img.getWidth();
+
+	if (tiledPaintedPixels) {
+		return !unpaintedPixels.test(pixel % imgWidth, pixel / imgWidth);
+	}
+
+	const unsigned char* paintedPixel = getPaintedPixel(pixel % imgWidth, pixel / imgWidth);
+	return paintedPixel[0] != BACKGROUND_COLOR.r || paintedPixel[1] != BACKGROUND_COLOR.g
+			|| paintedPixel[2] != BACKGROUND_COLOR.b;
+}
+
+bool ofxOilSimulator::alreadyVisitedTrajectory(const ofxOilTrace& candidate) const {
 	// Extract some useful information
-	const vector<glm::vec2>& positions = trace.getTrajectoryPositions();
-	const vector<unsigned char>& alphas = trace.getTrajectoryAphas();
+	const vector<glm::vec2>& positions = candidate.getTrajectoryPositions();
+	const vector<unsigned char>& alphas = candidate.getTrajectoryAphas();
 	int width = visitedPixels.getWidth();
 	int height = visitedPixels.getHeight();
 
@@ -297,7 +1367,7 @@ bool ofxOilSimulator::alreadyVisitedTrajectory() const {
 	int insideCounter = 0;
 	int visitedCounter = 0;
 
-	for (unsigned int i = ofxOilBrush::POSITIONS_FOR_AVERAGE, nSteps = trace.getNSteps(); i < nSteps; ++i) {
+	for (unsigned int i = ofxOilBrush::POSITIONS_FOR_AVERAGE, nSteps = candidate.getNSteps(); i < nSteps; ++i) {
 		// Check that the alpha value is high enough
 		if (alphas[i] >= ofxOilTrace::MIN_ALPHA) {
 			// Check that the position is inside the image
@@ -308,7 +1378,7 @@ bool ofxOilSimulator::alreadyVisitedTrajectory() const {
 			if (x >= 0 && x < width && y >= 0 && y < height) {
 				++insideCounter;
 
-				if (visitedPixels.getColor(x, y) == 0) {
+				if (visitedPixels.test(x, y)) {
 					++visitedCounter;
 				}
 			}
@@ -318,10 +1388,10 @@ bool ofxOilSimulator::alreadyVisitedTrajectory() const {
 	return visitedCounter > MAX_VISITS_FRACTION_IN_TRAJECTORY * insideCounter;
 }
 
-bool ofxOilSimulator::validTrajectory() const {
+bool ofxOilSimulator::validTrajectory(const ofxOilTrace& candidate) const {
 	// Extract some useful information
-	const vector<glm::vec2>& positions = trace.getTrajectoryPositions();
-	const vector<unsigned char>& alphas = trace.getTrajectoryAphas();
+	const vector<glm::vec2>& positions = candidate.getTrajectoryPositions();
+	const vector<unsigned char>& alphas = candidate.getTrajectoryAphas();
 	int width = img.getWidth();
 	int height = img.getHeight();
 
@@ -336,7 +1406,7 @@ bool ofxOilSimulator::validTrajectory() const {
 	float imgBlueSum = 0;
 	float imgBlueSqSum = 0;
 
-	for (unsigned int i = ofxOilBrush::POSITIONS_FOR_AVERAGE, nSteps = trace.getNSteps(); i < nSteps; ++i) {
+	for (unsigned int i = ofxOilBrush::POSITIONS_FOR_AVERAGE, nSteps = candidate.getNSteps(); i < nSteps; ++i) {
 		// Check that the alpha value is high enough
 		if (alphas[i] >= ofxOilTrace::MIN_ALPHA) {
 			// Check that the position is inside the image
@@ -344,12 +1414,13 @@ bool ofxOilSimulator::validTrajectory() const {
 			int x = pos.x;
 			int y = pos.y;
 
-			if (x >= 0 && x < width && y >= 0 && y < height) {
+			if (x >= 0 && x < width && y >= 0 && y < height && isMaskedPixel(x, y)) {
 				++insideCounter;
 
 				// Get the image color and the painted color at the trajectory position
-				const ofColor& imgColor = img.getColor(x, y);
-				const ofColor& paintedColor = paintedPixels.getColor(x, y);
+				ofColor imgColor = img.getColor(x, y);
+				const unsigned char* paintedPixel = getPaintedPixel(x, y);
+				ofColor paintedColor(paintedPixel[0], paintedPixel[1], paintedPixel[2]);
 
 				// Check if the two colors are similar
 				if (paintedColor != BACKGROUND_COLOR && abs(imgColor.r - paintedColor.r) < MAX_COLOR_DIFFERENCE[0]
@@ -394,12 +1465,24 @@ bool ofxOilSimulator::validTrajectory() const {
 	return insideCanvas && badPainted && smallColorChange;
 }
 
-bool ofxOilSimulator::traceImprovesPainting() const {
+bool ofxOilSimulator::traceImprovesPainting(const ofxOilTrace& candidate, float& errorReduction) const {
 	// Extract some useful information
-	const vector<unsigned char>& alphas = trace.getTrajectoryAphas();
-	const vector<vector<ofColor>>& bristleImgColors = trace.getBristleImageColors();
-	const vector<vector<ofColor>>& bristlePaintedColors = trace.getBristlePaintedColors();
-	const vector<vector<ofColor>>& bristleColors = trace.getBristleColors();
+	const vector<unsigned char>& alphas = candidate.getTrajectoryAphas();
+	const vector<ofColor>& bristleImgColors = candidate.getBristleImageColors();
+	const vector<ofColor>& bristlePaintedColors = candidate.getBristlePaintedColors();
+	const vector<ofColor>& bristleColors = candidate.getBristleColors();
+	const vector<glm::vec2>& bristlePositions = candidate.getBristlePositions();
+	unsigned int nBristles = candidate.getNBristles();
+	float averageMaxColorDiff = (MAX_COLOR_DIFFERENCE[0] + MAX_COLOR_DIFFERENCE[1] + MAX_COLOR_DIFFERENCE[2]) / 3.0;
+
+	// Get the trajectory steps where the alpha value is high enough and the bristle positions are defined
+	vector<unsigned int> steps;
+
+	for (unsigned int i = candidate.getFirstBristleStep(), nSteps = candidate.getNSteps(); i < nSteps; ++i) {
+		if (alphas[i] >= ofxOilTrace::MIN_ALPHA) {
+			steps.push_back(i);
+		}
+	}
 
 	// Obtain some trace statistics
 	int insideCounter = 0;
@@ -409,71 +1492,149 @@ bool ofxOilSimulator::traceImprovesPainting() const {
 	int wellPaintedCounter = 0;
 	int destroyedSimilarColorCounter = 0;
 	int colorImprovement = 0;
+	int unpaintedColorImprovement = 0;
+
+	// Each test below is the sign of a sum of per bristle terms. The early decision mode keeps the sums of the
+	// sampled terms and their squares.
+	array<double, 7> termSums = { };
+	array<double, 7> termSqSums = { };
+	unsigned int nSamples = steps.size() * nBristles;
+	bool earlyDecision = USE_EARLY_TRACE_DECISION && nSamples > MIN_EARLY_DECISION_SAMPLES;
+
+	// Visit the bristles with a fixed stride that is coprime with the number of samples, so any prefix of the
+	// visiting order is spread along the whole trace
+	unsigned int stride = 1;
+
+	if (earlyDecision) {
+		auto gcd = [](unsigned int a, unsigned int b) {
+			while (b != 0) {
+				a %= b;
+				swap(a, b);
+			}
 
-	for (unsigned int i = 0, nSteps = trace.getNSteps(); i < nSteps; ++i) {
-		// Check that the alpha value is high enough
-		if (alphas[i] >= ofxOilTrace::MIN_ALPHA) {
-			// Get the bristles image colors and painted colors for this step
-			const vector<ofColor>& bic = bristleImgColors[i];
-			const vector<ofColor>& bpc = bristlePaintedColors[i];
-			const vector<ofColor>& bc = bristleColors[i];
-
-			// Make sure that the containers are not empty
-			if (bic.size() > 0) {
-				for (unsigned int bristle = 0, nBristles = trace.getNBristles(); bristle < nBristles; ++bristle) {
-					// Get the image color and the painted color at the bristle position
-					const ofColor& imgColor = bic[bristle];
-					const ofColor& paintedColor = bpc[bristle];
-					const ofColor& bristleColor = bc[bristle];
-
-					// Check that the bristle is inside the image
-					if (imgColor.a != 0) {
-						++insideCounter;
-
-						// Count the number of painted pixels
-						bool paintedPixel = paintedColor.a != 0;
-
-						if (paintedPixel) {
-							++paintedCounter;
-						}
+			return a;
+		};
 
-						// Count the number of painted pixels whose color is similar to the image color
-						int redPaintedDiff = abs(imgColor.r - paintedColor.r);
-						int greenPaintedDiff = abs(imgColor.g - paintedColor.g);
-						int bluePaintedDiff = abs(imgColor.b - paintedColor.b);
-						bool similarColorPixel = paintedPixel && redPaintedDiff < MAX_COLOR_DIFFERENCE[0]
-								&& greenPaintedDiff < MAX_COLOR_DIFFERENCE[1]
-								&& bluePaintedDiff < MAX_COLOR_DIFFERENCE[2];
+		stride = max(1u, static_cast<unsigned int>(0.618034 * nSamples));
 
-						if (similarColorPixel) {
-							++similarColorCounter;
-						}
+		while (gcd(stride, nSamples) != 1) {
+			++stride;
+		}
+	}
 
-						// Count the number of pixels that will be well painted
-						int redAverageDiff = abs(imgColor.r - bristleColor.r);
-						int greenAverageDiff = abs(imgColor.g - bristleColor.g);
-						int blueAverageDiff = abs(imgColor.b - bristleColor.b);
-						bool wellPaintedPixel = redAverageDiff < MAX_COLOR_DIFFERENCE[0]
-								&& greenAverageDiff < MAX_COLOR_DIFFERENCE[1]
-								&& blueAverageDiff < MAX_COLOR_DIFFERENCE[2];
+	for (unsigned int sample = 0, index = 0; sample < nSamples; ++sample, index = (index + stride) % nSamples) {
+		// Get the image color and the painted color at the bristle position
+		unsigned int bristleIndex = steps[index / nBristles] * nBristles + index % nBristles;
+		const ofColor& imgColor = bristleImgColors[bristleIndex];
+		const ofColor& paintedColor = bristlePaintedColors[bristleIndex];
+		const ofColor& bristleColor = bristleColors[bristleIndex];
+		const glm::vec2& pos = bristlePositions[bristleIndex];
+		array<double, 7> terms = { -MIN_INSIDE_FRACTION, 0, 0, 0, 0, 0, 0 };
 
-						if (wellPaintedPixel) {
-							++wellPaintedCounter;
-						}
+		// Check that the bristle is inside the image and the painting mask
+		if (imgColor.a != 0 && isMaskedPixel(pos.x, pos.y)) {
+			++insideCounter;
 
-						// Count the number of pixels that will not be well painted anymore
-						if (similarColorPixel && !wellPaintedPixel) {
-							++destroyedSimilarColorCounter;
-						}
+			// Count the number of painted pixels
+			bool paintedPixel = paintedColor.a != 0;
 
-						// Calculate the color improvement
-						if (paintedPixel) {
-							colorImprovement += redPaintedDiff - redAverageDiff + greenPaintedDiff - greenAverageDiff
-									+ bluePaintedDiff - blueAverageDiff;
-						}
-					} else {
-						++outsideCounter;
-					}
+			if (paintedPixel) {
+				++paintedCounter;
+			}
+
+			// Count the number of painted pixels whose color is similar to the image color
+			int redPaintedDiff = abs(imgColor.r - paintedColor.r);
+			int greenPaintedDiff = abs(imgColor.g - paintedColor.g);
+			int bluePaintedDiff = abs(imgColor.b - paintedColor.b);
+			bool similarColorPixel = paintedPixel && redPaintedDiff < MAX_COLOR_DIFFERENCE[0]
+					&& greenPaintedDiff < MAX_COLOR_DIFFERENCE[1] && bluePaintedDiff < MAX_COLOR_DIFFERENCE[2];
+
+			if (similarColorPixel) {
+				++similarColorCounter;
+			}
+
+			// Count the number of pixels that will be well painted
+			int redAverageDiff = abs(imgColor.r - bristleColor.r);
+			int greenAverageDiff = abs(imgColor.g - bristleColor.g);
+			int blueAverageDiff = abs(imgColor.b - bristleColor.b);
+			bool wellPaintedPixel = redAverageDiff < MAX_COLOR_DIFFERENCE[0]
+					&& greenAverageDiff < MAX_COLOR_DIFFERENCE[1] && blueAverageDiff < MAX_COLOR_DIFFERENCE[2];
+
+			if (wellPaintedPixel) {
+				++wellPaintedCounter;
+			}
+
+			// Count the number of pixels that will not be well painted anymore
+			bool destroyedPixel = similarColorPixel && !wellPaintedPixel;
+
+			if (destroyedPixel) {
+				++destroyedSimilarColorCounter;
+			}
+
+			// Calculate the color improvement
+			int pixelColorImprovement = 0;
+
+			if (paintedPixel) {
+				pixelColorImprovement = redPaintedDiff - redAverageDiff + greenPaintedDiff - greenAverageDiff
+						+ bluePaintedDiff - blueAverageDiff;
+				colorImprovement += pixelColorImprovement;
+			} else {
+				unpaintedColorImprovement += abs(imgColor.r - BACKGROUND_COLOR.r) - redAverageDiff
+						+ abs(imgColor.g - BACKGROUND_COLOR.g) - greenAverageDiff
+						+ abs(imgColor.b - BACKGROUND_COLOR.b) - blueAverageDiff;
+			}
+
+			// Calculate the bristle terms for each test
+			if (earlyDecision) {
+				int wellPaintedChange = wellPaintedPixel - similarColorPixel;
+				terms[0] += 1;
+				terms[1] = similarColorPixel - MAX_SIMILAR_COLOR_FRACTION;
+				terms[2] = paintedPixel - MAX_PAINTED_FRACTION;
+				terms[3] = pixelColorImprovement - MIN_COLOR_IMPROVEMENT_FACTOR * averageMaxColorDiff * paintedPixel;
+				terms[4] = wellPaintedChange - BIG_WELL_PAINTED_IMPROVEMENT_FRACTION;
+				terms[5] = wellPaintedChange - MIN_BAD_PAINTED_REDUCTION_FRACTION * (1 - similarColorPixel);
+				terms[6] = MAX_WELL_PAINTED_DESTRUCTION_FRACTION * wellPaintedChange - destroyedPixel;
+			}
+		} else {
+			++outsideCounter;
+		}
+
+		// Check if the sampled bristles are enough to decide the result
+		if (earlyDecision) {
+			for (unsigned int t = 0; t < terms.size(); ++t) {
+				termSums[t] += terms[t];
+				termSqSums[t] += terms[t] * terms[t];
+			}
+
+			unsigned int n = sample + 1;
+
+			if (n >= MIN_EARLY_DECISION_SAMPLES && n % max(EARLY_DECISION_INTERVAL, 1u) == 0 && n < nSamples) {
+				// Get the sign of each test total sum, or 0 if the confidence interval contains zero
+				array<int, 7> signs;
+				float populationCorrection = 1 - float(n) / nSamples;
+
+				for (unsigned int t = 0; t < terms.size(); ++t) {
+					double mean = termSums[t] / n;
+					double variance = max(0.0, termSqSums[t] / n - mean * mean);
+					double margin = EARLY_DECISION_CONFIDENCE * sqrt(variance * populationCorrection / n);
+					signs[t] = mean - margin > 0 ? 1 : (mean + margin < 0 ? -1 : 0);
+				}
+
+				// Evaluate the final decision in three-valued logic (1 true, -1 false, 0 unknown)
+				auto orValue = [](int a, int b) {return max(a, b);};
+				auto andValue = [](int a, int b) {return min(a, b);};
+				int outsideValue = -signs[0];
+				int alreadyWellPaintedValue = signs[1];
+				int alreadyPaintedValue = signs[2];
+				int improvesValue = andValue(andValue(orValue(signs[3], signs[4]), signs[5]), signs[6]);
+				int rejectValue = orValue(orValue(outsideValue, alreadyWellPaintedValue),
+						andValue(alreadyPaintedValue, -improvesValue));
+
+				if (rejectValue != 0) {
+					// Extrapolate the sampled error reduction
+					errorReduction = insideCounter > 0 ?
+							float(colorImprovement + unpaintedColorImprovement) / insideCounter : 0;
+					return rejectValue < 0;
 				}
 			}
 		}
@@ -481,7 +1642,6 @@ bool ofxOilSimulator::traceImprovesPainting() const {
 
 	int wellPaintedImprovement = wellPaintedCounter - similarColorCounter;
 	int previouslyBadPainted = insideCounter - similarColorCounter;
-	float averageMaxColorDiff = (MAX_COLOR_DIFFERENCE[0] + MAX_COLOR_DIFFERENCE[1] + MAX_COLOR_DIFFERENCE[2]) / 3.0;
 
 	bool outsideCanvas = insideCounter < MIN_INSIDE_FRACTION * (insideCounter + outsideCounter);
 	bool alreadyWellPainted = similarColorCounter > MAX_SIMILAR_COLOR_FRACTION * insideCounter;
@@ -493,47 +1653,333 @@ bool ofxOilSimulator::traceImprovesPainting() const {
 			<= MAX_WELL_PAINTED_DESTRUCTION_FRACTION * wellPaintedImprovement;
 	bool improves = (colorImproves || bigWellPaintedImprovement) && reducedBadPainted && lowWellPaintedDestruction;
 
+	// Calculate the expected error reduction per bristle position inside the canvas
+	errorReduction = insideCounter > 0 ? float(colorImprovement + unpaintedColorImprovement) / insideCounter : 0;
+
 	// Check if the trace will improve the painting
 	return (outsideCanvas || alreadyWellPainted || (alreadyPainted && !improves)) ? false : true;
 }
 
 void ofxOilSimulator::paintTrace() {
-	// Pain the trace in the canvas and the canvas buffer if necessary
-	canvas.begin();
-	useCanvasBuffer ? trace.paint(canvasBuffer) : trace.paint();
-	canvas.end();
+	// Paint the trace in the canvas and the canvas buffer if necessary
+	if (cpuCanvas) {
+		trace.paint(canvasPixels, useCanvasBuffer ? &canvasBufferPixels : nullptr);
+		canvasTextureIsOutdated = true;
+		return;
+	}
+
+	beginCanvas();
+
+	if (USE_RIBBON_RENDERER) {
+		if (useCanvasBuffer) {
+			canvasShader.setUniform1f("ribbonMode", 1);
+		}
+
+		trace.paintRibbons();
+	} else {
+		trace.paint();
+	}
+
+	endCanvas();
 }
 
 void ofxOilSimulator::paintTraceStep() {
-	// Pain the trace step in the canvas and the canvas buffer if necessary
-	canvas.begin();
-	useCanvasBuffer ? trace.paintStep(traceStep, canvasBuffer) : trace.paintStep(traceStep);
-	canvas.end();
+	// Paint the trace step in the canvas and the canvas buffer if necessary
+	if (cpuCanvas) {
+		trace.paintStep(traceStep, canvasPixels, useCanvasBuffer ? &canvasBufferPixels : nullptr);
+		canvasTextureIsOutdated = true;
+	} else {
+		beginCanvas();
+		trace.paintStep(traceStep);
+		endCanvas();
+	}
 
 	// Increment the trace step
 	++traceStep;
 }
 
 void ofxOilSimulator::drawCanvas(float x, float y) const {
-	canvas.draw(x, y);
+	if (cpuCanvas) {
+		// Update the canvas texture if necessary
+		if (canvasTextureIsOutdated && canvasPixels.isAllocated()) {
+			canvasTexture.loadData(canvasPixels);
+			canvasTextureIsOutdated = false;
+		}
+
+		if (canvasTexture.isAllocated()) {
+			canvasTexture.draw(x, y);
+		}
+	} else {
+		canvas.draw(x, y);
+	}
+}
+
+void ofxOilSimulator::getCanvasPixels(ofPixels& pixels) const {
+	if (cpuCanvas) {
+		pixels = canvasPixels;
+	} else {
+		canvas.readToPixels(pixels, 0);
+	}
 }
 
 void ofxOilSimulator::drawImage(float x, float y) const {
-	img.draw(x, y);
+	// Update the image texture if necessary
+	if (imgTextureIsOutdated && img.isValid()) {
+		ofPixels pixels;
+		img.toPixels(pixels);
+		imgTexture.loadData(pixels);
+		imgTextureIsOutdated = false;
+	}
+
+	if (imgTexture.isAllocated()) {
+		imgTexture.draw(x, y);
+	}
 }
 
 void ofxOilSimulator::drawVisitedPixels(float x, float y) const {
+	ofPixels pixels;
+	visitedPixels.toPixels(pixels, 0, 255);
 	ofImage visitedPixelsImg;
-	visitedPixelsImg.setFromPixels(visitedPixels);
+	visitedPixelsImg.setFromPixels(pixels);
 	visitedPixelsImg.draw(x, y);
 }
 
 void ofxOilSimulator::drawSimilarColorPixels(float x, float y) const {
 	ofImage similarColorPixelsImg;
-	similarColorPixelsImg.setFromPixels(similarColorPixels);
+
+	if (tiledSimilarColorPixels) {
+		ofPixels pixels;
+		tiledSimilarColorPixels->readRegion(pixels, 0, 0, tiledSimilarColorPixels->getWidth(),
+				tiledSimilarColorPixels->getHeight());
+		similarColorPixelsImg.setFromPixels(pixels);
+	} else {
+		similarColorPixelsImg.setFromPixels(similarColorPixels);
+	}
+
 	similarColorPixelsImg.draw(x, y);
 }
 
 bool ofxOilSimulator::isFinished() const {
 	return paintingIsFinised;
 }
+
+array<float, 3> ofxOilSimulator::getMeanAbsoluteError() const {
+	float nPixels = max(1.0f, float(nMaskedPixels));
+	return {absErrorSums[0] / nPixels, absErrorSums[1] / nPixels, absErrorSums[2] / nPixels};
+}
+
+array<float, 3> ofxOilSimulator::getMeanSquaredError() const {
+	float nPixels = max(1.0f, float(nMaskedPixels));
+	return {sqErrorSums[0] / nPixels, sqErrorSums[1] / nPixels, sqErrorSums[2] / nPixels};
+}
+
+float ofxOilSimulator::getPSNR() const {
+	array<float, 3> mse = getMeanSquaredError();
+	float averageMse = (mse[0] + mse[1] + mse[2]) / 3;
+	return averageMse > 0 ? 10 * log10(255 * 255 / averageMse) : numeric_limits<float>::infinity();
+}
+
+void ofxOilSimulator::setQualityLogging(bool logQuality) {
+	logPaintingQuality = logQuality;
+}
+
+const vector<ofxOilSimulator::QualitySample>& ofxOilSimulator::getQualityCurve() const {
+	return qualityCurve;
+}
+
+void ofxOilSimulator::saveQualityCurve(const string& fileName) const {
+	ofstream out(ofToDataPath(fileName, true));
+
+	if (!out) {
+		throw runtime_error("Could not open the quality curve file " + fileName);
+	}
+
+	out << "time,traces,psnr\n";
+
+	for (const QualitySample& sample : qualityCurve) {
+		out << sample.time << "," << sample.nTraces << "," << sample.psnr << "\n";
+	}
+}
+
+void ofxOilSimulator::saveCheckpoint(const string& fileName) const {
+	ofstream out(ofToDataPath(fileName, true), ios::binary);
+
+	if (!out) {
+		throw runtime_error("Could not open the checkpoint file " + fileName);
+	}
+
+	// Save the file header
+	out.write("OILSIM", 6);
+	ofxOilWrite(out, CHECKPOINT_VERSION);
+	ofxOilWrite(out, useCanvasBuffer);
+
+	// Save the image and the canvas pixels
+	ofPixels pixels;
+	img.toPixels(pixels);
+	ofxOilWrite(out, pixels);
+	getCanvasPixels(pixels);
+	ofxOilWrite(out, pixels);
+
+	if (useCanvasBuffer) {
+		if (cpuCanvas) {
+			ofxOilWrite(out, canvasBufferPixels);
+		} else {
+			canvas.readToPixels(pixels, 1);
+			ofxOilWrite(out, pixels);
+		}
+	}
+
+	// Save the painting mask
+	ofxOilWrite(out, hasMask());
+
+	if (hasMask()) {
+		ofxOilWrite(out, maskPixels);
+	}
+
+	// Save the simulation variables
+	visitedPixels.save(out);
+	ofxOilWrite(out, averageBrushSize);
+	ofxOilWrite(out, paintingIsFinised);
+	ofxOilWrite(out, obtainNewTrace);
+	ofxOilWrite(out, traceStep);
+	ofxOilWrite(out, nTraces);
+	trace.save(out);
+	ofxOilWrite(out, failedStarts);
+	ofxOilWrite(out, convergenceWork);
+	ofxOilWrite(out, convergenceBadPixels);
+
+	// Save the random number engine state
+	ostringstream engineStream;
+	engineStream << ofxOilGetRandomEngine();
+	string engineState = engineStream.str();
+	ofxOilWrite(out, vector<char>(engineState.begin(), engineState.end()));
+
+	if (!out) {
+		throw runtime_error("Could not write the checkpoint file " + fileName);
+	}
+}
+
+void ofxOilSimulator::loadCheckpoint(const string& fileName) {
+	ifstream in(ofToDataPath(fileName, true), ios::binary);
+
+	if (!in) {
+		throw runtime_error("Could not open the checkpoint file " + fileName);
+	}
+
+	// Check the file header
+	char magic[6];
+	uint32_t version = 0;
+	bool checkpointUsesCanvasBuffer = false;
+	in.read(magic, 6);
+	ofxOilRead(in, version);
+	ofxOilRead(in, checkpointUsesCanvasBuffer);
+
+	if (!in || string(magic, 6) != "OILSIM" || version != CHECKPOINT_VERSION) {
+		throw runtime_error("The file " + fileName + " is not a valid checkpoint file.");
+	} else if (checkpointUsesCanvasBuffer != useCanvasBuffer) {
+		throw runtime_error("The checkpoint canvas buffer setting doesn't match the simulator setting.");
+	}
+
+	// Read the image and the canvas pixels. The read functions check the saved sizes against the file length, so a
+	// corrupted file fails here instead of causing huge allocations.
+	ofPixels imgPixels;
+	ofPixels savedCanvasPixels;
+	ofPixels savedCanvasBufferPixels;
+	bool checkpointHasMask = false;
+	ofPixels savedMaskPixels;
+	vector<unsigned char> savedFailedStarts;
+	vector<char> engineState;
+
+	try {
+		ofxOilRead(in, imgPixels);
+		ofxOilRead(in, savedCanvasPixels);
+
+		if (useCanvasBuffer) {
+			ofxOilRead(in, savedCanvasBufferPixels);
+		}
+
+		// Read the painting mask
+		ofxOilRead(in, checkpointHasMask);
+
+		if (checkpointHasMask) {
+			ofxOilRead(in, savedMaskPixels);
+		}
+
+		// Read the simulation variables
+		visitedPixels.load(in);
+		ofxOilRead(in, averageBrushSize);
+		ofxOilRead(in, paintingIsFinised);
+		ofxOilRead(in, obtainNewTrace);
+		ofxOilRead(in, traceStep);
+		ofxOilRead(in, nTraces);
+		trace.load(in);
+		ofxOilRead(in, savedFailedStarts);
+		ofxOilRead(in, convergenceWork);
+		ofxOilRead(in, convergenceBadPixels);
+
+		// Read the random number engine state
+		ofxOilRead(in, engineState);
+	} catch (const runtime_error& e) {
+		throw runtime_error("Unexpected end of the checkpoint file " + fileName + ": " + e.what());
+	}
+
+	if (!in) {
+		throw runtime_error("Unexpected end of the checkpoint file " + fileName);
+	}
+
+	istringstream(string(engineState.begin(), engineState.end())) >> ofxOilGetRandomEngine();
+
+	// The quality curve is not part of the checkpoint, so it starts again like for a new image
+	paintingStartTime = ofGetElapsedTimef();
+	qualityCurve.clear();
+
+	// Restore the image and the pixel arrays
+	imgPixelsCopy = imgPixels;
+	img = ofxOilPixelView(imgPixelsCopy);
+	imgTextureIsOutdated = true;
+	int imgWidth = img.getWidth();
+	int imgHeight = img.getHeight();
+	allocatePixelArrays(imgWidth, imgHeight);
+
+	// Restore the painting mask
+	maskPixels = savedMaskPixels;
+	updateMaskSpans();
+	updateDetailMap();
+	updateFlowField();
+
+	// Restore the failed starts counters
+	resetFailedStarts();
+
+	if (savedFailedStarts.size() != failedStarts.size()) {
+		throw runtime_error("The checkpoint failed starts counters don't match the image dimensions.");
+	}
+
+	failedStarts = savedFailedStarts;
+
+	// Restore the canvas and the canvas buffer contents
+	allocateCanvas(imgWidth, imgHeight);
+
+	if (cpuCanvas) {
+		canvasPixels = savedCanvasPixels;
+		canvasBufferPixels = savedCanvasBufferPixels;
+	} else {
+		ofPushStyle();
+		ofSetColor(255);
+		canvas.begin();
+		canvas.setActiveDrawBuffer(0);
+		ofImage(savedCanvasPixels).draw(0, 0);
+
+		if (useCanvasBuffer) {
+			canvas.setActiveDrawBuffer(1);
+			ofImage(savedCanvasBufferPixels).draw(0, 0);
+		}
+
+		canvas.activateAllDrawBuffers();
+		canvas.end();
+		ofPopStyle();
+
+		if (multisampleCanvas.isAllocated()) {
+			multisampleCanvas.load(canvas);
+		}
+	}
+}
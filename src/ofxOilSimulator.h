@@ -2,6 +2,11 @@
 
 #include "ofMain.h"
 #include "ofxOilTrace.h"
+#include "ofxOilBitMask.h"
+#include "ofxOilPixelView.h"
+#include "ofxOilFlowField.h"
+#include "ofxOilTiledPixels.h"
+#include "ofxOilMultisampleFbo.h"
 
 /**
  * @brief Class used to simulate an oil paint
@@ -11,6 +16,51 @@
 class ofxOilSimulator {
 public:
 
+	/**
+	 * @brief The limits that can stop the paintUntil method
+	 */
+	enum class StopReason {
+		/**
+		 * @brief The simulator finished the painting
+		 */
+		PAINTING_FINISHED,
+
+		/**
+		 * @brief The painting reached the target peak signal-to-noise ratio
+		 */
+		TARGET_QUALITY,
+
+		/**
+		 * @brief The maximum number of traces was painted
+		 */
+		MAX_TRACES,
+
+		/**
+		 * @brief The deadline was reached
+		 */
+		DEADLINE
+	};
+
+	/**
+	 * @brief Structure that stores the painting quality at a given time
+	 */
+	struct QualitySample {
+		/**
+		 * @brief The time since the painting started in seconds
+		 */
+		float time;
+
+		/**
+		 * @brief The number of painted traces
+		 */
+		unsigned int nTraces;
+
+		/**
+		 * @brief The painting peak signal-to-noise ratio in dB
+		 */
+		float psnr;
+	};
+
 	/**
 	 * @brief The smaller brush size allowed
 	 */
@@ -27,7 +77,8 @@ public:
 	static unsigned int MAX_INVALID_TRAJECTORIES;
 
 	/**
-	 * @brief The maximum number of invalid trajectories allowed for the smaller brush size before the painting is finished
+	 * @brief The maximum number of invalid trajectories allowed for the smaller brush size before the painting is
+	 * finished
 	 */
 	static unsigned int MAX_INVALID_TRAJECTORIES_FOR_SMALLER_SIZE;
 
@@ -41,6 +92,54 @@ public:
 	 */
 	static unsigned int MAX_INVALID_TRACES_FOR_SMALLER_SIZE;
 
+	/**
+	 * @brief The minimum number of bad painted pixels that should be fixed per evaluated trace candidate to continue
+	 * with the current brush size. If the reduction rate falls below this value, the brush size is reduced (or the
+	 * painting is finished for the smaller brush size). Set it to zero to disable this behavior.
+	 */
+	static float MIN_BAD_PAINTED_REDUCTION_RATE;
+
+	/**
+	 * @brief The number of evaluated trace candidates used to measure the bad painted pixels reduction rate
+	 */
+	static unsigned int CONVERGENCE_WINDOW;
+
+	/**
+	 * @brief The number of failed traces starting in a region after which the region pixels are not used anymore as
+	 * starting pixels for the current brush size. Zero, the default value, disables this behavior. It cannot be
+	 * higher than 255.
+	 */
+	static unsigned int MAX_FAILED_STARTS_PER_REGION;
+
+	/**
+	 * @brief The size of the regions used to count the failed traces, relative to the brush size
+	 */
+	static float RELATIVE_FAILED_STARTS_REGION_SIZE;
+
+	/**
+	 * @brief The brush size below which the low detail regions are skipped and the starting pixels are selected
+	 * preferentially in the high detail regions
+	 */
+	static float DETAIL_BRUSH_SIZE;
+
+	/**
+	 * @brief The size in pixels of the blocks used to calculate the image detail map
+	 */
+	static unsigned int DETAIL_BLOCK_SIZE;
+
+	/**
+	 * @brief The minimum block detail (the maximum luminance gradient inside the block) needed to use the block
+	 * pixels as starting pixels below the DETAIL_BRUSH_SIZE. Unpainted pixels are always used. Zero, the default
+	 * value, disables the skipping.
+	 */
+	static unsigned char MIN_DETAIL;
+
+	/**
+	 * @brief The number of random starting pixels drawn below the DETAIL_BRUSH_SIZE. The pixel with the highest
+	 * detail is used. One, the default value, disables the sampling.
+	 */
+	static unsigned int DETAIL_SAMPLING_CHOICES;
+
 	/**
 	 * @brief The trace speed in pixels/step
 	 */
@@ -126,22 +225,96 @@ public:
 	 */
 	static float MAX_WELL_PAINTED_DESTRUCTION_FRACTION;
 
+	/**
+	 * @brief The number of pixel buffers used in the asynchronous canvas readback mode
+	 */
+	static unsigned int READBACK_BUFFERS;
+
+	/**
+	 * @brief The number of traces with a valid trajectory that are evaluated in parallel before one is painted
+	 *
+	 * Only the trace with the largest expected error reduction per bristle position will be painted. 1 means that
+	 * the first trace that improves the painting is painted.
+	 */
+	static unsigned int CANDIDATE_TRACES;
+
+	/**
+	 * @brief Sets if the complete traces should be painted as one ribbon per bristle in a single draw call
+	 *
+	 * It's much faster than painting the brush at each trajectory step, but only approximates its look. Traces
+	 * painted step by step are not affected.
+	 */
+	static bool USE_RIBBON_RENDERER;
+
+	/**
+	 * @brief Sets if the trace trajectories should be steered along the image edges by a flow field
+	 *
+	 * The flow field is calculated for each new image. Trajectories that don't cross the edges are accepted more
+	 * often, at the cost of a less random look.
+	 */
+	static bool USE_FLOW_FIELD;
+
+	/**
+	 * @brief Sets if the trace evaluation can stop before all the bristles are visited
+	 *
+	 * The bristles are visited in a scrambled order, and the evaluation stops as soon as the confidence intervals of
+	 * the sampled test statistics decide the outcome. Traces close to the test thresholds are evaluated exactly.
+	 */
+	static bool USE_EARLY_TRACE_DECISION;
+
+	/**
+	 * @brief The minimum number of bristle positions sampled before an early trace decision can be taken
+	 */
+	static unsigned int MIN_EARLY_DECISION_SAMPLES;
+
+	/**
+	 * @brief The number of sampled bristle positions between two early trace decision checks
+	 */
+	static unsigned int EARLY_DECISION_INTERVAL;
+
+	/**
+	 * @brief The confidence interval half width, in standard deviations, used for the early trace decisions
+	 */
+	static float EARLY_DECISION_CONFIDENCE;
+
 	/**
 	 * @brief Constructor
 	 *
-	 * @param _useCanvasBuffer sets if the simulator should use a canvas buffer for the color mixing calculation
+	 * @param _useCanvasBuffer sets if the simulator should use a canvas buffer for the color mixing calculation. The
+	 * GL canvas buffer is not antialiased, and the canvas is only multisampled in that case with the programmable
+	 * renderer and desktop OpenGL
 	 * @param _verbose sets if the simulator should print some debugging information
+	 * @param _asyncReadback sets if the canvas pixels should be read asynchronously. The simulator will then work
+	 * with a painted pixels snapshot that is READBACK_BUFFERS - 1 traces old, while the next snapshots are
+	 * transferred.
+	 * @param _cpuCanvas sets if the canvas should be painted on the CPU, without using OpenGL. It is slower, but the
+	 * simulator can then run outside the main thread. The image cannot be drawn in this mode.
 	 */
-	ofxOilSimulator(bool _useCanvasBuffer = true, bool _verbose = true);
+	ofxOilSimulator(bool _useCanvasBuffer = true, bool _verbose = true, bool _asyncReadback = false,
+			bool _cpuCanvas = false);
 
 	/**
 	 * @brief Sets the pixels of the image that should be painted
 	 *
+	 * The simulator keeps a copy of the pixels.
+	 *
 	 * @param imagePixels the pixels of the image that should be painted
 	 * @param clearCanvas if true the canvas will be cleared before the painting starts
 	 */
 	void setImagePixels(const ofPixels& imagePixels, bool clearCanvas);
 
+	/**
+	 * @brief Sets the pixels of the image that should be painted without copying them
+	 *
+	 * The image colors are sampled directly from the view, and the image texture is only created if the drawImage
+	 * method is called. The view data should stay valid and unchanged while the image is painted, or until the next
+	 * call to one of the setImage methods.
+	 *
+	 * @param imageView the view of the image pixels that should be painted
+	 * @param clearCanvas if true the canvas will be cleared before the painting starts
+	 */
+	void setImagePixels(const ofxOilPixelView& imageView, bool clearCanvas);
+
 	/**
 	 * @brief Sets the image that should be painted
 	 *
@@ -150,6 +323,55 @@ public:
 	 */
 	void setImage(const ofImage& image, bool clearCanvas);
 
+	/**
+	 * @brief Restricts the painting to a masked area of the image
+	 *
+	 * Only the masked pixels are used as trace starting pixels, to validate the trace trajectories, to decide if the
+	 * painting is finished and to calculate the error metrics, so the simulation time scales with the masked area.
+	 * The traces can still paint a few pixels outside the mask along its border.
+	 *
+	 * The mask is kept for the next images if they have the same dimensions. It should be set after the image.
+	 *
+	 * @param mask the mask pixels, with the same dimensions as the image. Pixels with a non-zero value in the first
+	 * channel are painted.
+	 */
+	void setMask(const ofPixels& mask);
+
+	/**
+	 * @brief Restricts the painting to some regions of interest of the image
+	 *
+	 * @param regions the regions of interest
+	 * @see setMask(const ofPixels&)
+	 */
+	void setMask(const vector<ofRectangle>& regions);
+
+	/**
+	 * @brief Removes the painting mask, so the whole image is painted
+	 */
+	void clearMask();
+
+	/**
+	 * @brief Indicates if the painting is restricted to a masked area
+	 *
+	 * @return true if the painting is restricted to a masked area
+	 */
+	bool hasMask() const;
+
+	/**
+	 * @brief Stores the painted pixels and the similar color pixels arrays in memory mapped files
+	 *
+	 * Only the tiles around the traces that are evaluated are kept in memory, which saves 4 bytes per image pixel.
+	 * The image, the canvas, the mask, the visited pixels, the detail map, the bad painted pixels list and the flow
+	 * field temporaries are still kept in memory, so this mode doesn't remove the image size limit. It can only be
+	 * used with the CPU canvas. The candidate traces are evaluated one after the other in this mode, and only the
+	 * pixels painted by the last trace are checked again after each trace.
+	 *
+	 * @param filePrefix the path prefix of the temporary files where the pixel arrays will be stored. Each simulator
+	 * should use a different prefix. The files are deleted when they are not used anymore. An empty string keeps the
+	 * pixel arrays in memory.
+	 */
+	void setOutOfCoreStorage(const string& filePrefix);
+
 	/**
 	 * @brief Updates the simulation
 	 *
@@ -158,6 +380,20 @@ public:
 	 */
 	void update(bool stepByStep);
 
+	/**
+	 * @brief Paints complete traces until one of the given limits is reached or the painting is finished
+	 *
+	 * The limits are checked before each new trace is obtained. The time limit is also checked while the candidate
+	 * traces are searched. A trace that was being painted step by step is completed first.
+	 *
+	 * @param targetPsnr the target peak signal-to-noise ratio in dB, as returned by getPSNR. 0 means no quality
+	 * limit.
+	 * @param maxTraces the maximum number of traces to paint in this call. 0 means no traces limit.
+	 * @param maxSeconds the maximum time to spend in this call in seconds. 0 means no time limit.
+	 * @return the limit that stopped the painting
+	 */
+	StopReason paintUntil(float targetPsnr, unsigned int maxTraces, float maxSeconds);
+
 	/**
 	 * @brief Draws the canvas on the screen
 	 *
@@ -166,6 +402,13 @@ public:
 	 */
 	void drawCanvas(float x, float y) const;
 
+	/**
+	 * @brief Returns the canvas pixels
+	 *
+	 * @param pixels the pixels container where the canvas pixels will be copied
+	 */
+	void getCanvasPixels(ofPixels& pixels) const;
+
 	/**
 	 * @brief Draws the painted image on the screen
 	 *
@@ -197,13 +440,220 @@ public:
 	 */
 	bool isFinished() const;
 
+	/**
+	 * @brief Returns the mean absolute difference between the painted pixels and the image pixels
+	 *
+	 * The error is updated incrementally, only over the canvas regions touched by the traces, every time that the
+	 * painted pixels are updated. Note that the painted pixels are the canvas buffer pixels when the simulator uses
+	 * a canvas buffer, not the visible canvas pixels. The buffer only contains the opaque trace steps, so its error
+	 * is larger than the visible canvas one.
+	 *
+	 * @return the mean absolute error for the red, green and blue channels
+	 */
+	array<float, 3> getMeanAbsoluteError() const;
+
+	/**
+	 * @brief Returns the mean squared difference between the painted pixels and the image pixels
+	 *
+	 * As in getMeanAbsoluteError, the canvas buffer pixels are measured when the buffer is used.
+	 *
+	 * @return the mean squared error for the red, green and blue channels
+	 */
+	array<float, 3> getMeanSquaredError() const;
+
+	/**
+	 * @brief Returns the peak signal-to-noise ratio of the painted pixels relative to the image pixels
+	 *
+	 * As in getMeanAbsoluteError, the canvas buffer pixels are measured when the buffer is used.
+	 *
+	 * @return the peak signal-to-noise ratio in dB
+	 */
+	float getPSNR() const;
+
+	/**
+	 * @brief Sets if the painting quality should be logged every time that the painted pixels are updated
+	 *
+	 * @param logQuality true if the painting quality should be logged
+	 */
+	void setQualityLogging(bool logQuality);
+
+	/**
+	 * @brief Returns the logged painting quality as a function of time
+	 *
+	 * @return the logged quality samples for the current painting
+	 */
+	const vector<QualitySample>& getQualityCurve() const;
+
+	/**
+	 * @brief Saves the logged painting quality as a function of time in a CSV file
+	 *
+	 * @param fileName the CSV file name
+	 */
+	void saveQualityCurve(const string& fileName) const;
+
+	/**
+	 * @brief Saves the complete simulator state in a checkpoint file
+	 *
+	 * The checkpoint includes the painted image, the canvas pixels, the visited pixels mask, the current trace and
+	 * the random number engine state, so a simulation resumed with loadCheckpoint will continue exactly as the
+	 * original one. This is only true for the CPU canvas. The GL canvas is multisampled, and only its resolved
+	 * pixels are stored, so the resumed painting can differ slightly from the original one at the trace edges. The
+	 * resumed painting also differs when the out of core storage is used, since the bad painted pixels list is
+	 * rebuilt in a different order.
+	 *
+	 * @param fileName the checkpoint file name
+	 */
+	void saveCheckpoint(const string& fileName) const;
+
+	/**
+	 * @brief Restores the simulator state from a checkpoint file
+	 *
+	 * Note that the simulator static parameters are not part of the checkpoint. They should have the same values
+	 * that they had when the checkpoint was saved. The quality curve is not part of the checkpoint either, so it
+	 * starts again from the resumed painting.
+	 *
+	 * @param fileName the checkpoint file name
+	 */
+	void loadCheckpoint(const string& fileName);
+
 protected:
 
+	/**
+	 * @brief Allocates the canvas and the canvas buffer and fills them with the background color
+	 *
+	 * @param width the canvas width
+	 * @param height the canvas height
+	 */
+	void allocateCanvas(int width, int height);
+
+	/**
+	 * @brief Loads the shader that paints the canvas and the canvas buffer in a single pass
+	 */
+	void setupCanvasShader();
+
+	/**
+	 * @brief Starts painting on the canvas, and on the canvas buffer if necessary
+	 */
+	void beginCanvas();
+
+	/**
+	 * @brief Stops painting on the canvas
+	 */
+	void endCanvas();
+
+	/**
+	 * @brief Allocates the similar color pixels and the bad painted pixels arrays, in memory or in the out of core
+	 * storage files
+	 *
+	 * @param width the image width
+	 * @param height the image height
+	 */
+	void allocatePixelArrays(int width, int height);
+
+	/**
+	 * @brief Returns the painted pixel channels at a given position
+	 *
+	 * Note that the pointer is only valid until another painted pixel is requested.
+	 *
+	 * @param x the pixel x position
+	 * @param y the pixel y position
+	 * @return a pointer to the painted pixel red, green and blue channels
+	 */
+	const unsigned char* getPaintedPixel(unsigned int x, unsigned int y) const;
+
+	/**
+	 * @brief Sets the value of a similar color pixel
+	 *
+	 * @param x the pixel x position
+	 * @param y the pixel y position
+	 * @param value 0 if the pixel is well painted and 255 otherwise
+	 */
+	void setSimilarColorPixel(unsigned int x, unsigned int y, unsigned char value);
+
 	/**
 	 * @brief Updates the pixel arrays
+	 *
+	 * When the painted pixels are stored out of core, only the pixels painted since the last update are checked
+	 * again.
 	 */
 	void updatePixelArrays();
 
+	/**
+	 * @brief Updates the similar color pixels array for a masked pixel and adds it to the bad painted pixels list if
+	 * it's not well painted
+	 *
+	 * @param x the pixel x position
+	 * @param y the pixel y position
+	 */
+	void updateBadPaintedPixel(unsigned int x, unsigned int y);
+
+	/**
+	 * @brief Updates the painted pixels array and the error metric
+	 *
+	 * Only the pixels inside the mask bounds are updated, except after the canvas or the pixel arrays are allocated.
+	 */
+	void updatePaintedPixels();
+
+	/**
+	 * @brief Updates the painted pixels array using a ring of pixel buffers
+	 *
+	 * A new transfer of the canvas pixels inside the mask bounds is started on each call, and the transfer started
+	 * READBACK_BUFFERS - 1 calls before is used to update the painted pixels.
+	 */
+	void updatePaintedPixelsAsync();
+
+	/**
+	 * @brief Returns the canvas region that should be copied to the painted pixels when the error sums are not valid
+	 *
+	 * It's the whole canvas if the painted pixels are outdated, and the mask bounds otherwise.
+	 *
+	 * @return the canvas region to copy
+	 */
+	ofRectangle getPaintedPixelsRefreshRegion();
+
+	/**
+	 * @brief Copies a region of the canvas pixels to the in memory painted pixels
+	 *
+	 * The painted pixels are allocated if necessary.
+	 *
+	 * @param data the canvas pixels data, with 3 channels
+	 * @param stride the number of bytes between the start of two consecutive rows
+	 * @param region the canvas region to copy
+	 */
+	void copyToPaintedPixels(const unsigned char* data, size_t stride, const ofRectangle& region);
+
+	/**
+	 * @brief Reads a region of the GL canvas into the painted pixels
+	 *
+	 * @param region the canvas region to read
+	 */
+	void readCanvasRegion(const ofRectangle& region);
+
+	/**
+	 * @brief Adds or subtracts the contribution of a canvas region to the error sums
+	 *
+	 * The sums are calculated over the whole canvas if they are not valid.
+	 *
+	 * @param region the canvas region
+	 * @param sign 1 to add the region contribution or -1 to subtract it
+	 */
+	void updateErrorSums(const ofRectangle& region, int sign);
+
+	/**
+	 * @brief Returns the canvas region that will be covered by the current trace
+	 *
+	 * @return the canvas region covered by the current trace
+	 */
+	ofRectangle getTraceRegion() const;
+
+	/**
+	 * @brief Grows a region to include another region, taking into account that any of them could be empty
+	 *
+	 * @param region the region to grow
+	 * @param newRegion the region to include
+	 */
+	static void growRegion(ofRectangle& region, const ofRectangle& newRegion);
+
 	/**
 	 * @brief Updates the visited pixels array
 	 */
@@ -211,15 +661,95 @@ protected:
 
 	/**
 	 * @brief Gets a new trace for the simulation
+	 *
+	 * @param deadline the elapsed time in seconds after which the search should be abandoned. 0 means no deadline.
+	 * @return false if the deadline was reached before a new trace was found
+	 */
+	bool getNewTrace(float deadline = 0);
+
+	/**
+	 * @brief Checks if the painting has converged for the current brush size
+	 *
+	 * The bad painted pixels reduction rate is measured over windows of CONVERGENCE_WINDOW evaluated trace
+	 * candidates. A new window starts every time that the rate is measured.
+	 *
+	 * @return true if the bad painted pixels reduction rate in the last window was lower than
+	 * MIN_BAD_PAINTED_REDUCTION_RATE
+	 */
+	bool hasConverged();
+
+	/**
+	 * @brief Starts a new window for the convergence measurement
+	 */
+	void resetConvergenceWindow();
+
+	/**
+	 * @brief Resets the failed starts counters and adapts their regions to the current brush size
+	 */
+	void resetFailedStarts();
+
+	/**
+	 * @brief Calculates the masked pixel spans and resets the similar color pixels outside the mask
+	 */
+	void updateMaskSpans();
+
+	/**
+	 * @brief Checks if a pixel is inside the painting mask
+	 *
+	 * @param x the pixel x position
+	 * @param y the pixel y position
+	 * @return true if the pixel is inside the painting mask or there is no mask
+	 */
+	bool isMaskedPixel(unsigned int x, unsigned int y) const;
+
+	/**
+	 * @brief Calculates the image detail map
+	 */
+	void updateDetailMap();
+
+	/**
+	 * @brief Calculates the image flow field if it's used, or removes it otherwise
+	 */
+	void updateFlowField();
+
+	/**
+	 * @brief Returns the image detail around a given pixel
+	 *
+	 * @param pixel the pixel index
+	 * @return the maximum luminance gradient in the pixel detail block
+	 */
+	unsigned char getPixelDetail(unsigned int pixel) const;
+
+	/**
+	 * @brief Checks if a pixel lies in a low detail region that should be skipped with the current brush size
+	 *
+	 * @param pixel the pixel index
+	 * @return true if the pixel is painted, lies in a low detail region and the brush size is below DETAIL_BRUSH_SIZE
+	 */
+	bool isLowDetailPixel(unsigned int pixel) const;
+
+	/**
+	 * @brief Registers a failed trace that started at the given pixel
+	 *
+	 * @param pixel the trace starting pixel index
+	 */
+	void addFailedStart(unsigned int pixel);
+
+	/**
+	 * @brief Checks if a pixel should not be used anymore as a starting pixel for the current brush size
+	 *
+	 * @param pixel the pixel index
+	 * @return true if too many traces starting in the pixel region have failed
 	 */
-	void getNewTrace();
+	bool isDiscardedStartingPixel(unsigned int pixel) const;
 
 	/**
 	 * @brief Checks if the trace trajectory falls in a region that has been visited before
 	 *
+	 * @param candidate the trace to check
 	 * @return true if the trace trajectory falls in a region that has been visited before
 	 */
-	bool alreadyVisitedTrajectory() const;
+	bool alreadyVisitedTrajectory(const ofxOilTrace& candidate) const;
 
 	/**
 	 * @brief Checks if the trace trajectory is valid
@@ -227,19 +757,22 @@ protected:
 	 * To be valid it should fall on a region that was not painted correctly before, it should fall most of the time
 	 * inside the canvas, and the image color changes should be small.
 	 *
+	 * @param candidate the trace to check
 	 * @return true if the trace has a valid trajectory
 	 */
-	bool validTrajectory() const;
+	bool validTrajectory(const ofxOilTrace& candidate) const;
 
 	/**
 	 * @brief Checks if drawing the trace will improve the overall painting
 	 *
 	 * Note that the calculateBristleColors method should have been run before.
 	 *
+	 * @param candidate the trace to check
+	 * @param errorReduction the expected color error reduction per bristle position inside the canvas
 	 * @return false if the region covered by the trace was already painted with similar colors, most of the trace is
 	 *         outside the canvas, or drawing the trace will not improve considerably the painting
 	 */
-	bool traceImprovesPainting() const;
+	bool traceImprovesPainting(const ofxOilTrace& candidate, float& errorReduction) const;
 
 	/**
 	 * @brief Paints the current trace
@@ -262,24 +795,149 @@ protected:
 	bool verbose;
 
 	/**
-	 * @brief The image to paint
+	 * @brief Sets if the canvas pixels should be read asynchronously
+	 */
+	bool asyncReadback;
+
+	/**
+	 * @brief Sets if the canvas should be painted on the CPU
+	 */
+	bool cpuCanvas;
+
+	/**
+	 * @brief The ring of pixel buffers used for the asynchronous canvas readback
+	 */
+	vector<ofBufferObject> readbackBuffers;
+
+	/**
+	 * @brief The canvas region painted before each transfer in the readback ring was started
+	 */
+	vector<ofRectangle> readbackRegions;
+
+	/**
+	 * @brief The canvas region transferred by each buffer in the readback ring
+	 */
+	vector<ofRectangle> readbackCopyRegions;
+
+	/**
+	 * @brief Indicates if all the painted pixels should be updated, and not only those inside the mask bounds
+	 */
+	bool paintedPixelsAreOutdated;
+
+	/**
+	 * @brief The number of canvas transfers started since the readback ring was reset
+	 */
+	unsigned int nReadbacks;
+
+	/**
+	 * @brief The number of the last canvas transfer used to update the painted pixels
+	 */
+	unsigned int nConsumedReadbacks;
+
+	/**
+	 * @brief The canvas region painted since the painted pixels were last read
+	 */
+	ofRectangle dirtyRegion;
+
+	/**
+	 * @brief The sums of the absolute differences between the painted pixels and the image pixels per channel
+	 */
+	array<int64_t, 3> absErrorSums;
+
+	/**
+	 * @brief The sums of the squared differences between the painted pixels and the image pixels per channel
+	 */
+	array<int64_t, 3> sqErrorSums;
+
+	/**
+	 * @brief Indicates if the error sums are valid for the current painted pixels and image
+	 */
+	bool errorSumsAreValid;
+
+	/**
+	 * @brief Sets if the painting quality should be logged
 	 */
-	ofImage img;
+	bool logPaintingQuality;
+
+	/**
+	 * @brief The time when the current painting started
+	 */
+	float paintingStartTime;
+
+	/**
+	 * @brief The logged painting quality samples
+	 */
+	vector<QualitySample> qualityCurve;
+
+	/**
+	 * @brief The view of the image to paint
+	 */
+	ofxOilPixelView img;
+
+	/**
+	 * @brief The image pixels, when the simulator owns a copy of them
+	 */
+	ofPixels imgPixelsCopy;
+
+	/**
+	 * @brief The image texture, created only when the image is drawn
+	 */
+	mutable ofTexture imgTexture;
+
+	/**
+	 * @brief Indicates that the image texture should be updated before it is drawn
+	 */
+	mutable bool imgTextureIsOutdated;
 
 	/**
 	 * @brief The canvas where the oil painting is done
+	 *
+	 * When the canvas buffer is used, it is stored in the second color attachment of the canvas. The canvas is then
+	 * single sampled, and it holds the resolved multisampleCanvas attachments.
 	 */
 	ofFbo canvas;
 
 	/**
-	 * @brief The canvas buffer used for the color mixing calculation
+	 * @brief The multisampled attachments where the canvas and the canvas buffer are painted in a single pass
+	 *
+	 * It's only allocated when the canvas buffer is used and the multisampled attachments are supported.
+	 */
+	ofxOilMultisampleFbo multisampleCanvas;
+
+	/**
+	 * @brief The shader used to paint the canvas and the canvas buffer in a single pass
 	 */
-	ofFbo canvasBuffer;
+	ofShader canvasShader;
 
 	/**
-	 * @brief Container indicating which canvas pixels have been visited by previous traces
+	 * @brief The canvas pixels when the canvas is painted on the CPU
 	 */
-	ofPixels visitedPixels;
+	ofPixels canvasPixels;
+
+	/**
+	 * @brief The canvas buffer pixels when the canvas is painted on the CPU
+	 */
+	ofPixels canvasBufferPixels;
+
+	/**
+	 * @brief The texture used to draw the canvas pixels when the canvas is painted on the CPU
+	 */
+	mutable ofTexture canvasTexture;
+
+	/**
+	 * @brief Indicates if the canvas texture needs to be updated with the canvas pixels
+	 */
+	mutable bool canvasTextureIsOutdated;
+
+	/**
+	 * @brief Mask indicating which canvas pixels have been visited by previous traces
+	 */
+	ofxOilBitMask visitedPixels;
+
+	/**
+	 * @brief The image flow field used to steer the trace trajectories
+	 */
+	ofxOilFlowField flowField;
 
 	/**
 	 * @brief Container with the colors of the currently painted pixels
@@ -291,8 +949,52 @@ protected:
 	 */
 	ofPixels similarColorPixels;
 
+	/**
+	 * @brief The path prefix of the out of core storage files. It is empty when the pixel arrays are in memory.
+	 */
+	string outOfCorePrefix;
+
+	/**
+	 * @brief The painted pixels when they are stored out of core
+	 */
+	unique_ptr<ofxOilTiledPixels> tiledPaintedPixels;
+
+	/**
+	 * @brief The similar color pixels when they are stored out of core
+	 */
+	unique_ptr<ofxOilTiledPixels> tiledSimilarColorPixels;
+
+	/**
+	 * @brief The bad painted pixels that still have the background color, when the painted pixels are stored out of
+	 * core
+	 */
+	ofxOilBitMask unpaintedPixels;
+
+	/**
+	 * @brief The painting mask. It is not allocated when the whole image is painted.
+	 */
+	ofPixels maskPixels;
+
+	/**
+	 * @brief The horizontal runs of masked pixels, stored as (row, first column, last column)
+	 */
+	vector<array<unsigned int, 3>> maskSpans;
+
+	/**
+	 * @brief The number of masked pixels
+	 */
+	unsigned int nMaskedPixels;
+
+	/**
+	 * @brief The bounding box of the masked pixels
+	 */
+	ofRectangle maskBounds;
+
 	/**
 	 * @brief Container with the indices of pixels that are currently bad painted
+	 *
+	 * The first nStartingPixels elements are the pixels that can still be used as trace starting pixels for the
+	 * current brush size.
 	 */
 	vector<unsigned int> badPaintedPixels;
 
@@ -301,6 +1003,51 @@ protected:
 	 */
 	unsigned int nBadPaintedPixels;
 
+	/**
+	 * @brief The number of bad painted pixels that can be used as trace starting pixels
+	 */
+	unsigned int nStartingPixels;
+
+	/**
+	 * @brief The number of trace candidates evaluated in the current convergence window
+	 */
+	unsigned int convergenceWork;
+
+	/**
+	 * @brief The number of bad painted pixels at the start of the current convergence window
+	 */
+	unsigned int convergenceBadPixels;
+
+	/**
+	 * @brief The number of failed traces that started in each region for the current brush size
+	 */
+	vector<unsigned char> failedStarts;
+
+	/**
+	 * @brief The size of the regions used to count the failed traces
+	 */
+	unsigned int failedStartsRegionSize;
+
+	/**
+	 * @brief The number of regions in each row of regions
+	 */
+	unsigned int failedStartsRegionsPerRow;
+
+	/**
+	 * @brief The maximum luminance gradient inside each block of the image
+	 */
+	vector<unsigned char> detailMap;
+
+	/**
+	 * @brief The size in pixels of the detail map blocks
+	 */
+	unsigned int detailBlockSize;
+
+	/**
+	 * @brief The number of blocks in each row of the detail map
+	 */
+	unsigned int detailBlocksPerRow;
+
 	/**
 	 * @brief The current average brush size
 	 */
@@ -330,4 +1077,9 @@ protected:
 	 * @brief The total number of painted traces
 	 */
 	unsigned int nTraces;
+
+	/**
+	 * @brief The checkpoint files format version
+	 */
+	static const uint32_t CHECKPOINT_VERSION;
 };
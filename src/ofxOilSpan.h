@@ -0,0 +1,140 @@
+#pragma once
+
+#include "ofMain.h"
+
+/**
+ * @brief Class that gives access to a contiguous sequence of elements that it doesn't own
+ *
+ * It's a minimal replacement for std::span. The elements should stay valid while the span is used.
+ *
+ * @author Javier Graciá Carpio
+ */
+template<typename T>
+class ofxOilSpan {
+public:
+
+	/**
+	 * @brief The type of the elements without the const qualifier
+	 */
+	typedef typename remove_const<T>::type value_type;
+
+	/**
+	 * @brief Constructor of an empty span
+	 */
+	ofxOilSpan() :
+			first(nullptr), length(0) {
+	}
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param _first the first element
+	 * @param _length the number of elements
+	 */
+	ofxOilSpan(T* _first, size_t _length) :
+			first(_first), length(_length) {
+	}
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param values the vector with the elements
+	 */
+	ofxOilSpan(vector<value_type>& values) :
+			first(values.data()), length(values.size()) {
+	}
+
+	/**
+	 * @brief Constructor. It can only be used with spans of const elements.
+	 *
+	 * @param values the vector with the elements
+	 */
+	ofxOilSpan(const vector<value_type>& values) :
+			first(values.data()), length(values.size()) {
+	}
+
+	/**
+	 * @brief Returns the element at a given position
+	 *
+	 * Note that the position is not checked to be inside the span.
+	 *
+	 * @param index the element position
+	 * @return the element
+	 */
+	T& operator[](size_t index) const {
+		return first[index];
+	}
+
+	/**
+	 * @brief Returns a span with part of the elements
+	 *
+	 * @param offset the position of the first element
+	 * @param count the number of elements
+	 * @return a span with the elements
+	 */
+	ofxOilSpan<T> subspan(size_t offset, size_t count) const {
+		// Check that the input makes sense
+		if (offset + count > length) {
+			throw out_of_range("The subspan should be inside the span.");
+		}
+
+		return ofxOilSpan<T>(first + offset, count);
+	}
+
+	/**
+	 * @brief Returns a pointer to the first element
+	 *
+	 * @return a pointer to the first element
+	 */
+	T* data() const {
+		return first;
+	}
+
+	/**
+	 * @brief Returns an iterator to the first element
+	 *
+	 * @return an iterator to the first element
+	 */
+	T* begin() const {
+		return first;
+	}
+
+	/**
+	 * @brief Returns an iterator past the last element
+	 *
+	 * @return an iterator past the last element
+	 */
+	T* end() const {
+		return first + length;
+	}
+
+	/**
+	 * @brief Returns the number of elements
+	 *
+	 * @return the number of elements
+	 */
+	size_t size() const {
+		return length;
+	}
+
+	/**
+	 * @brief Indicates if the span has no elements
+	 *
+	 * @return true if the span has no elements
+	 */
+	bool empty() const {
+		return length == 0;
+	}
+
+protected:
+
+	/**
+	 * @brief The first element
+	 */
+	T* first;
+
+	/**
+	 * @brief The number of elements
+	 */
+	size_t length;
+};
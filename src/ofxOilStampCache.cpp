@@ -0,0 +1,109 @@
+#include "ofxOilStampCache.h"
+#include "ofMain.h"
+
+float ofxOilStampCache::THICKNESS_STEP = 0.25;
+
+float ofxOilStampCache::LENGTH_STEP = 0.25;
+
+unsigned int ofxOilStampCache::ANGLE_STEPS = 64;
+
+unsigned int ofxOilStampCache::SUBPIXEL_STEPS = 4;
+
+float ofxOilStampCache::MAX_STAMP_SIZE = 48;
+
+unsigned int ofxOilStampCache::MAX_CACHED_STAMPS = 4096;
+
+const ofxOilStampCache::Stamp* ofxOilStampCache::getStamp(const glm::vec2& start, const glm::vec2& end,
+		float startThickness, float endThickness) {
+	// Check that the segment is not too large
+	glm::vec2 direction = end - start;
+	float length = sqrt(direction.x * direction.x + direction.y * direction.y);
+
+	if (length + max(startThickness, endThickness) > MAX_STAMP_SIZE) {
+		return nullptr;
+	}
+
+	// Quantize the segment properties
+	unsigned int subpixelSteps = max(SUBPIXEL_STEPS, 1u);
+	unsigned int angleSteps = max(ANGLE_STEPS, 1u);
+	uint64_t xIndex = min(unsigned(subpixelSteps * (start.x - floor(start.x))), subpixelSteps - 1);
+	uint64_t yIndex = min(unsigned(subpixelSteps * (start.y - floor(start.y))), subpixelSteps - 1);
+	uint64_t angleIndex = unsigned(round(angleSteps * (atan2(direction.y, direction.x) / TWO_PI + 0.5)))
+			% angleSteps;
+	uint64_t lengthIndex = round(length / LENGTH_STEP);
+	uint64_t startThicknessIndex = round(max(startThickness, 0.0f) / THICKNESS_STEP);
+	uint64_t endThicknessIndex = round(max(endThickness, 0.0f) / THICKNESS_STEP);
+	uint64_t key = (startThicknessIndex << 48) | (endThicknessIndex << 36) | (lengthIndex << 24) | (angleIndex << 12)
+			| (yIndex << 6) | xIndex;
+
+	// Return the stamp if it's already in the cache, marking it as the most recently used
+	Cache& cache = getCache();
+	auto position = cache.positions.find(key);
+
+	if (position != cache.positions.end()) {
+		cache.stamps.splice(cache.stamps.begin(), cache.stamps, position->second);
+		return &position->second->second;
+	}
+
+	// Drop the least recently used stamps if the cache is full
+	while (!cache.stamps.empty() && cache.stamps.size() >= max(MAX_CACHED_STAMPS, 1u)) {
+		cache.positions.erase(cache.stamps.back().first);
+		cache.stamps.pop_back();
+	}
+
+	// Rasterize the quantized segment and add it to the cache
+	float angle = TWO_PI * (float(angleIndex) / angleSteps - 0.5);
+	float quantizedLength = lengthIndex * LENGTH_STEP;
+	glm::vec2 quantizedStart((xIndex + 0.5f) / subpixelSteps, (yIndex + 0.5f) / subpixelSteps);
+	glm::vec2 quantizedEnd = quantizedStart + quantizedLength * glm::vec2(cos(angle), sin(angle));
+
+	cache.stamps.emplace_front(key, rasterize(quantizedStart, quantizedEnd, startThicknessIndex * THICKNESS_STEP,
+			endThicknessIndex * THICKNESS_STEP));
+	cache.positions[key] = cache.stamps.begin();
+	return &cache.stamps.front().second;
+}
+
+void ofxOilStampCache::clear() {
+	Cache& cache = getCache();
+	cache.stamps.clear();
+	cache.positions.clear();
+}
+
+ofxOilStampCache::Stamp ofxOilStampCache::rasterize(const glm::vec2& start, const glm::vec2& end,
+		float startThickness, float endThickness) {
+	// Calculate the stamp bounding box
+	float maxRadius = max(0.5f * max(startThickness, endThickness), 0.5f);
+	Stamp stamp;
+	stamp.x = floor(min(start.x, end.x) - maxRadius);
+	stamp.y = floor(min(start.y, end.y) - maxRadius);
+	stamp.width = int(ceil(max(start.x, end.x) + maxRadius)) - stamp.x + 1;
+	stamp.height = int(ceil(max(start.y, end.y) + maxRadius)) - stamp.y + 1;
+	stamp.coverage.resize(stamp.width * stamp.height);
+
+	// Calculate the coverage of each pixel, interpolating the thickness along the segment
+	glm::vec2 direction = end - start;
+	float lengthSq = direction.x * direction.x + direction.y * direction.y;
+
+	for (int y = 0; y < stamp.height; ++y) {
+		for (int x = 0; x < stamp.width; ++x) {
+			float px = stamp.x + x + 0.5f - start.x;
+			float py = stamp.y + y + 0.5f - start.y;
+			float t = lengthSq > 0 ? ofClamp((px * direction.x + py * direction.y) / lengthSq, 0, 1) : 0;
+			float dx = px - t * direction.x;
+			float dy = py - t * direction.y;
+			float thickness = startThickness + t * (endThickness - startThickness);
+			float radius = max(0.5f * thickness, 0.5f);
+
+			// Segments thinner than one pixel only cover part of the pixels
+			float coverage = ofClamp(radius + 0.5f - sqrt(dx * dx + dy * dy), 0, 1) * min(thickness, 1.0f);
+			stamp.coverage[y * stamp.width + x] = round(255 * coverage);
+		}
+	}
+
+	return stamp;
+}
+
+ofxOilStampCache::Cache& ofxOilStampCache::getCache() {
+	thread_local Cache cache;
+	return cache;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "ofMain.h"
+#include <unordered_map>
+#include <list>
+
+/**
+ * @brief Class that caches pre-rasterized anti-aliased tapered segment stamps
+ *
+ * The stamps are keyed by the quantized segment length, angle, start and end thickness, and sub-pixel start position.
+ * They store the segment coverage of each pixel, so painting a segment reduces to blending the stamp pixels with the
+ * segment color. Each thread has its own cache, which drops the least recently used stamps when it's full.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilStampCache {
+public:
+
+	/**
+	 * @brief Structure that stores a pre-rasterized segment
+	 */
+	struct Stamp {
+		/**
+		 * @brief The stamp horizontal offset relative to the pixel that contains the segment start
+		 */
+		int x;
+
+		/**
+		 * @brief The stamp vertical offset relative to the pixel that contains the segment start
+		 */
+		int y;
+
+		/**
+		 * @brief The stamp width
+		 */
+		int width;
+
+		/**
+		 * @brief The stamp height
+		 */
+		int height;
+
+		/**
+		 * @brief The segment coverage at each stamp pixel, in the range [0, 255]
+		 */
+		vector<unsigned char> coverage;
+	};
+
+	/**
+	 * @brief The thickness quantization step
+	 */
+	static float THICKNESS_STEP;
+
+	/**
+	 * @brief The length quantization step
+	 */
+	static float LENGTH_STEP;
+
+	/**
+	 * @brief The number of quantized segment angles
+	 */
+	static unsigned int ANGLE_STEPS;
+
+	/**
+	 * @brief The number of quantized sub-pixel positions along each axis
+	 */
+	static unsigned int SUBPIXEL_STEPS;
+
+	/**
+	 * @brief The maximum segment length plus thickness that can be cached
+	 */
+	static float MAX_STAMP_SIZE;
+
+	/**
+	 * @brief The maximum number of stamps in each thread cache
+	 */
+	static unsigned int MAX_CACHED_STAMPS;
+
+	/**
+	 * @brief Returns the stamp for a tapered segment
+	 *
+	 * @param start the segment start position
+	 * @param end the segment end position
+	 * @param startThickness the segment thickness at the start position
+	 * @param endThickness the segment thickness at the end position
+	 * @return the segment stamp, or nullptr if the segment is too large to be cached. The pointer is valid until the
+	 * next call.
+	 */
+	static const Stamp* getStamp(const glm::vec2& start, const glm::vec2& end, float startThickness,
+			float endThickness);
+
+	/**
+	 * @brief Removes all the stamps from the current thread cache
+	 */
+	static void clear();
+
+protected:
+
+	/**
+	 * @brief Structure with the stamps cached by one thread
+	 */
+	struct Cache {
+		/**
+		 * @brief The stamps and their keys, from the most to the least recently used
+		 */
+		list<pair<uint64_t, Stamp>> stamps;
+
+		/**
+		 * @brief The position of each stamp in the stamps list
+		 */
+		unordered_map<uint64_t, list<pair<uint64_t, Stamp>>::iterator> positions;
+	};
+
+	/**
+	 * @brief Rasterizes a tapered segment
+	 *
+	 * @param start the segment start position relative to the stamp origin pixel
+	 * @param end the segment end position relative to the stamp origin pixel
+	 * @param startThickness the segment thickness at the start position
+	 * @param endThickness the segment thickness at the end position
+	 * @return the segment stamp
+	 */
+	static Stamp rasterize(const glm::vec2& start, const glm::vec2& end, float startThickness, float endThickness);
+
+	/**
+	 * @brief Returns the current thread stamps cache
+	 *
+	 * @return the current thread stamps cache
+	 */
+	static Cache& getCache();
+};
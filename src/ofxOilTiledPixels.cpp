@@ -0,0 +1,354 @@
+#include "ofxOilTiledPixels.h"
+#include "ofMain.h"
+
+#ifndef TARGET_WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+unsigned int ofxOilTiledPixels::TILE_SIZE = 256;
+
+unsigned int ofxOilTiledPixels::MAX_MAPPED_TILES = 64;
+
+namespace {
+
+/**
+ * @brief The file offsets of the tiles should be multiple of this value (the Windows allocation granularity)
+ */
+const size_t TILE_ALIGNMENT = 65536;
+
+const unsigned int NO_TILE = numeric_limits<unsigned int>::max();
+
+}
+
+ofxOilTiledPixels::ofxOilTiledPixels() :
+		width(0), height(0), nChannels(0), tileSize(TILE_SIZE), tilesPerRow(0), tileBytes(0), lastTile(NO_TILE) {
+#ifdef TARGET_WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+ofxOilTiledPixels::~ofxOilTiledPixels() {
+	close();
+}
+
+void ofxOilTiledPixels::allocate(unsigned int _width, unsigned int _height, unsigned int _nChannels,
+		const string& filePath) {
+	// Check that the input makes sense
+	if (_width == 0 || _height == 0 || _nChannels == 0) {
+		throw invalid_argument("The container dimensions and number of channels should be higher than zero.");
+	} else if (TILE_SIZE == 0 || MAX_MAPPED_TILES == 0) {
+		throw invalid_argument("The tile size and the maximum number of mapped tiles should be higher than zero.");
+	}
+
+	// Close the previous file if necessary
+	close();
+
+	// Calculate the tiles layout
+	width = _width;
+	height = _height;
+	nChannels = _nChannels;
+	tileSize = TILE_SIZE;
+	tilesPerRow = (width + tileSize - 1) / tileSize;
+	unsigned int nTiles = tilesPerRow * ((height + tileSize - 1) / tileSize);
+	tileBytes = ((size_t(tileSize) * tileSize * nChannels + TILE_ALIGNMENT - 1) / TILE_ALIGNMENT) * TILE_ALIGNMENT;
+	uint64_t fileSize = uint64_t(nTiles) * tileBytes;
+
+	// Create an empty file with the correct size. The file is deleted when it's closed.
+#ifdef TARGET_WIN32
+	fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ | GENERIC_WRITE | DELETE, 0, NULL, CREATE_ALWAYS,
+			FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		throw runtime_error("Could not open the tiled pixels file " + filePath);
+	}
+
+	LARGE_INTEGER newSize;
+	newSize.QuadPart = fileSize;
+
+	if (!SetFilePointerEx(fileHandle, newSize, NULL, FILE_BEGIN) || !SetEndOfFile(fileHandle)) {
+		close();
+		throw runtime_error("Could not resize the tiled pixels file " + filePath);
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE, DWORD(fileSize >> 32),
+			DWORD(fileSize & 0xFFFFFFFF), NULL);
+
+	if (mappingHandle == NULL) {
+		close();
+		throw runtime_error("Could not create the tiled pixels file mapping for " + filePath);
+	}
+#else
+	fileDescriptor = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+	if (fileDescriptor < 0) {
+		throw runtime_error("Could not open the tiled pixels file " + filePath);
+	}
+
+	// The open descriptor keeps the file data until it's closed
+	unlink(filePath.c_str());
+
+	if (ftruncate(fileDescriptor, fileSize) != 0) {
+		close();
+		throw runtime_error("Could not resize the tiled pixels file " + filePath);
+	}
+#endif
+
+	// Initialize the tiles containers
+	tilesData = vector<unsigned char*>(nTiles, nullptr);
+	mappedTilesPositions = vector<list<unsigned int>::iterator>(nTiles);
+	mappedTiles.clear();
+	lastTile = NO_TILE;
+}
+
+void ofxOilTiledPixels::close() {
+	// Unmap all the tiles
+	while (!mappedTiles.empty()) {
+		unmapTile(mappedTiles.back());
+	}
+
+	// Close the file
+#ifdef TARGET_WIN32
+	if (mappingHandle != NULL) {
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+
+	if (fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (fileDescriptor >= 0) {
+		::close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+#endif
+
+	tilesData.clear();
+	mappedTilesPositions.clear();
+	lastTile = NO_TILE;
+}
+
+unsigned char* ofxOilTiledPixels::getPixel(unsigned int x, unsigned int y) {
+	unsigned int tile = (y / tileSize) * tilesPerRow + x / tileSize;
+	unsigned int pixel = (y % tileSize) * tileSize + x % tileSize;
+	return getTileData(tile) + pixel * nChannels;
+}
+
+ofColor ofxOilTiledPixels::getColor(unsigned int x, unsigned int y) {
+	const unsigned char* pixel = getPixel(x, y);
+
+	if (nChannels >= 4) {
+		return ofColor(pixel[0], pixel[1], pixel[2], pixel[3]);
+	} else if (nChannels == 3) {
+		return ofColor(pixel[0], pixel[1], pixel[2]);
+	} else {
+		return ofColor(pixel[0]);
+	}
+}
+
+void ofxOilTiledPixels::setColor(unsigned int x, unsigned int y, const ofColor& color) {
+	unsigned char* pixel = getPixel(x, y);
+
+	if (nChannels >= 3) {
+		pixel[0] = color.r;
+		pixel[1] = color.g;
+		pixel[2] = color.b;
+
+		if (nChannels >= 4) {
+			pixel[3] = color.a;
+		}
+	} else {
+		pixel[0] = color.getBrightness();
+	}
+}
+
+void ofxOilTiledPixels::setColor(const ofColor& color) {
+	// Calculate the pixel channel values
+	vector<unsigned char> pixel(nChannels, 0);
+
+	if (nChannels >= 3) {
+		pixel[0] = color.r;
+		pixel[1] = color.g;
+		pixel[2] = color.b;
+
+		if (nChannels >= 4) {
+			pixel[3] = color.a;
+		}
+	} else {
+		pixel[0] = color.getBrightness();
+	}
+
+	// Fill the tiles one after the other
+	size_t tilePixels = size_t(tileSize) * tileSize;
+
+	for (unsigned int tile = 0, nTiles = tilesData.size(); tile < nTiles; ++tile) {
+		unsigned char* data = getTileData(tile);
+
+		for (size_t i = 0; i < tilePixels; ++i) {
+			memcpy(data + i * nChannels, pixel.data(), nChannels);
+		}
+	}
+}
+
+void ofxOilTiledPixels::mapRegion(const ofRectangle& region) {
+	// Calculate the tiles that overlap with the region
+	int xMin = max(0, int(floor(region.getLeft())));
+	int yMin = max(0, int(floor(region.getTop())));
+	int xMax = min(int(width) - 1, int(floor(region.getRight())));
+	int yMax = min(int(height) - 1, int(floor(region.getBottom())));
+
+	// Map the tiles
+	for (int tileY = yMin / int(tileSize); tileY <= yMax / int(tileSize); ++tileY) {
+		for (int tileX = xMin / int(tileSize); tileX <= xMax / int(tileSize); ++tileX) {
+			getTileData(tileY * tilesPerRow + tileX);
+		}
+	}
+}
+
+void ofxOilTiledPixels::readRegion(ofPixels& pixels, unsigned int x, unsigned int y, unsigned int regionWidth,
+		unsigned int regionHeight) {
+	// Check that the input makes sense
+	if (x + regionWidth > width || y + regionHeight > height) {
+		throw invalid_argument("The region should fall inside the container.");
+	}
+
+	pixels.allocate(regionWidth, regionHeight, nChannels);
+	unsigned char* data = pixels.getData();
+
+	// Copy the region row by row, one tile segment at a time
+	for (unsigned int row = 0; row < regionHeight; ++row) {
+		for (unsigned int col = 0; col < regionWidth;) {
+			unsigned int segmentWidth = min(regionWidth - col, tileSize - (x + col) % tileSize);
+			memcpy(data + (size_t(row) * regionWidth + col) * nChannels, getPixel(x + col, y + row),
+					segmentWidth * nChannels);
+			col += segmentWidth;
+		}
+	}
+}
+
+void ofxOilTiledPixels::writeRegion(const ofPixels& pixels, unsigned int x, unsigned int y) {
+	// Check that the input makes sense
+	unsigned int regionWidth = pixels.getWidth();
+	unsigned int regionHeight = pixels.getHeight();
+
+	if (pixels.getNumChannels() != nChannels) {
+		throw invalid_argument("The pixels should have the same number of channels as the container.");
+	} else if (x + regionWidth > width || y + regionHeight > height) {
+		throw invalid_argument("The region should fall inside the container.");
+	}
+
+	const unsigned char* data = pixels.getData();
+
+	// Copy the region row by row, one tile segment at a time
+	for (unsigned int row = 0; row < regionHeight; ++row) {
+		for (unsigned int col = 0; col < regionWidth;) {
+			unsigned int segmentWidth = min(regionWidth - col, tileSize - (x + col) % tileSize);
+			memcpy(getPixel(x + col, y + row), data + (size_t(row) * regionWidth + col) * nChannels,
+					segmentWidth * nChannels);
+			col += segmentWidth;
+		}
+	}
+}
+
+void ofxOilTiledPixels::copyRegion(const ofPixels& pixels, unsigned int x, unsigned int y, unsigned int regionWidth,
+		unsigned int regionHeight) {
+	// Check that the input makes sense
+	if (pixels.getWidth() != width || pixels.getHeight() != height || pixels.getNumChannels() != nChannels) {
+		throw invalid_argument("The pixels should have the same dimensions and number of channels as the container.");
+	} else if (x + regionWidth > width || y + regionHeight > height) {
+		throw invalid_argument("The region should fall inside the container.");
+	}
+
+	const unsigned char* data = pixels.getData();
+
+	// Copy the region row by row, one tile segment at a time
+	for (unsigned int row = y; row < y + regionHeight; ++row) {
+		for (unsigned int col = x; col < x + regionWidth;) {
+			unsigned int segmentWidth = min(x + regionWidth - col, tileSize - col % tileSize);
+			memcpy(getPixel(col, row), data + (size_t(row) * width + col) * nChannels, segmentWidth * nChannels);
+			col += segmentWidth;
+		}
+	}
+}
+
+unsigned int ofxOilTiledPixels::getWidth() const {
+	return width;
+}
+
+unsigned int ofxOilTiledPixels::getHeight() const {
+	return height;
+}
+
+unsigned int ofxOilTiledPixels::getNumChannels() const {
+	return nChannels;
+}
+
+unsigned int ofxOilTiledPixels::getNumMappedTiles() const {
+	return mappedTiles.size();
+}
+
+unsigned char* ofxOilTiledPixels::getTileData(unsigned int tile) {
+	// Avoid touching the recently used list if we keep working on the same tile
+	if (tile != lastTile) {
+		if (tilesData[tile] == nullptr) {
+			// Make room for the new tile if necessary
+			if (mappedTiles.size() >= MAX_MAPPED_TILES) {
+				unmapTile(mappedTiles.back());
+			}
+
+			mapTile(tile);
+		} else {
+			// Move the tile to the front of the recently used list
+			mappedTiles.splice(mappedTiles.begin(), mappedTiles, mappedTilesPositions[tile]);
+		}
+
+		lastTile = tile;
+	}
+
+	return tilesData[tile];
+}
+
+void ofxOilTiledPixels::mapTile(unsigned int tile) {
+	uint64_t offset = uint64_t(tile) * tileBytes;
+	void* data;
+
+#ifdef TARGET_WIN32
+	data = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, DWORD(offset >> 32), DWORD(offset & 0xFFFFFFFF),
+			tileBytes);
+
+	if (data == NULL) {
+		throw runtime_error("Could not map the pixels tile " + ofToString(tile));
+	}
+#else
+	data = mmap(nullptr, tileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, offset);
+
+	if (data == MAP_FAILED) {
+		throw runtime_error("Could not map the pixels tile " + ofToString(tile));
+	}
+#endif
+
+	tilesData[tile] = static_cast<unsigned char*>(data);
+	mappedTiles.push_front(tile);
+	mappedTilesPositions[tile] = mappedTiles.begin();
+}
+
+void ofxOilTiledPixels::unmapTile(unsigned int tile) {
+#ifdef TARGET_WIN32
+	UnmapViewOfFile(tilesData[tile]);
+#else
+	munmap(tilesData[tile], tileBytes);
+#endif
+
+	tilesData[tile] = nullptr;
+	mappedTiles.erase(mappedTilesPositions[tile]);
+
+	if (tile == lastTile) {
+		lastTile = NO_TILE;
+	}
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "ofMain.h"
+
+/**
+ * @brief Class that stores a large pixels container in a memory mapped file, divided in square tiles
+ *
+ * Only a limited number of tiles are mapped into memory at the same time. When a pixel from a tile that is not mapped
+ * is requested, the least recently used tile is unmapped and the new tile is mapped in its place. This allows to work
+ * with pixel containers that don't fit in memory, as long as the accesses are localized around a given region (e.g.
+ * the current trace).
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilTiledPixels {
+public:
+
+	/**
+	 * @brief The tiles size in pixels
+	 */
+	static unsigned int TILE_SIZE;
+
+	/**
+	 * @brief The maximum number of tiles that can be mapped in memory at the same time
+	 */
+	static unsigned int MAX_MAPPED_TILES;
+
+	/**
+	 * @brief Constructor
+	 */
+	ofxOilTiledPixels();
+
+	/**
+	 * @brief Destructor
+	 */
+	~ofxOilTiledPixels();
+
+	ofxOilTiledPixels(const ofxOilTiledPixels&) = delete;
+
+	ofxOilTiledPixels& operator=(const ofxOilTiledPixels&) = delete;
+
+	/**
+	 * @brief Allocates the pixels container in the given file
+	 *
+	 * An existing file is overwritten. All the pixels are set to zero, and the file is deleted when the container is
+	 * closed, so it's only used as a swap space.
+	 *
+	 * @param _width the container width
+	 * @param _height the container height
+	 * @param _nChannels the number of channels per pixel
+	 * @param filePath the path to the file where the pixels will be stored
+	 */
+	void allocate(unsigned int _width, unsigned int _height, unsigned int _nChannels, const string& filePath);
+
+	/**
+	 * @brief Unmaps all the tiles and closes the pixels file, which deletes it
+	 */
+	void close();
+
+	/**
+	 * @brief Returns a pointer to the pixel data at the given position, mapping its tile if necessary
+	 *
+	 * Note that the pointer is only valid until a pixel from a different tile is requested.
+	 *
+	 * @param x the pixel x position
+	 * @param y the pixel y position
+	 * @return a pointer to the pixel channels
+	 */
+	unsigned char* getPixel(unsigned int x, unsigned int y);
+
+	/**
+	 * @brief Returns the color at the given position
+	 *
+	 * @param x the pixel x position
+	 * @param y the pixel y position
+	 * @return the pixel color
+	 */
+	ofColor getColor(unsigned int x, unsigned int y);
+
+	/**
+	 * @brief Sets the color at the given position
+	 *
+	 * @param x the pixel x position
+	 * @param y the pixel y position
+	 * @param color the pixel color
+	 */
+	void setColor(unsigned int x, unsigned int y, const ofColor& color);
+
+	/**
+	 * @brief Sets all the container pixels to the given color
+	 *
+	 * Note that all the tiles will be mapped into memory one after the other.
+	 *
+	 * @param color the pixels color
+	 */
+	void setColor(const ofColor& color);
+
+	/**
+	 * @brief Maps into memory all the tiles that overlap with the given region
+	 *
+	 * This can be used to page in the tiles around a trace before it is processed. Tiles outside the region might be
+	 * unmapped if the maximum number of mapped tiles is exceeded.
+	 *
+	 * @param region the region to map
+	 */
+	void mapRegion(const ofRectangle& region);
+
+	/**
+	 * @brief Copies a region of the container into a pixels object
+	 *
+	 * @param pixels the pixels object where the region will be copied
+	 * @param x the region x position
+	 * @param y the region y position
+	 * @param regionWidth the region width
+	 * @param regionHeight the region height
+	 */
+	void readRegion(ofPixels& pixels, unsigned int x, unsigned int y, unsigned int regionWidth,
+			unsigned int regionHeight);
+
+	/**
+	 * @brief Copies a pixels object into a region of the container
+	 *
+	 * @param pixels the pixels object to copy. It should have the same number of channels as the container.
+	 * @param x the region x position
+	 * @param y the region y position
+	 */
+	void writeRegion(const ofPixels& pixels, unsigned int x, unsigned int y);
+
+	/**
+	 * @brief Copies a region of a pixels object with the same dimensions as the container into the same container
+	 * region
+	 *
+	 * @param pixels the pixels object to copy. It should have the same dimensions and number of channels as the
+	 * container.
+	 * @param x the region x position
+	 * @param y the region y position
+	 * @param regionWidth the region width
+	 * @param regionHeight the region height
+	 */
+	void copyRegion(const ofPixels& pixels, unsigned int x, unsigned int y, unsigned int regionWidth,
+			unsigned int regionHeight);
+
+	/**
+	 * @brief Returns the container width
+	 *
+	 * @return the container width
+	 */
+	unsigned int getWidth() const;
+
+	/**
+	 * @brief Returns the container height
+	 *
+	 * @return the container height
+	 */
+	unsigned int getHeight() const;
+
+	/**
+	 * @brief Returns the number of channels per pixel
+	 *
+	 * @return the number of channels per pixel
+	 */
+	unsigned int getNumChannels() const;
+
+	/**
+	 * @brief Returns the number of tiles that are currently mapped in memory
+	 *
+	 * @return the number of tiles that are currently mapped in memory
+	 */
+	unsigned int getNumMappedTiles() const;
+
+protected:
+
+	/**
+	 * @brief Returns the data of the given tile, mapping it into memory if necessary
+	 *
+	 * @param tile the tile index
+	 * @return a pointer to the tile data
+	 */
+	unsigned char* getTileData(unsigned int tile);
+
+	/**
+	 * @brief Maps a tile into memory
+	 *
+	 * @param tile the tile index
+	 */
+	void mapTile(unsigned int tile);
+
+	/**
+	 * @brief Unmaps a tile from memory
+	 *
+	 * @param tile the tile index
+	 */
+	void unmapTile(unsigned int tile);
+
+	/**
+	 * @brief The container width
+	 */
+	unsigned int width;
+
+	/**
+	 * @brief The container height
+	 */
+	unsigned int height;
+
+	/**
+	 * @brief The number of channels per pixel
+	 */
+	unsigned int nChannels;
+
+	/**
+	 * @brief The tiles size used when the container was allocated
+	 */
+	unsigned int tileSize;
+
+	/**
+	 * @brief The number of tiles in each row of tiles
+	 */
+	unsigned int tilesPerRow;
+
+	/**
+	 * @brief The number of bytes reserved in the file for each tile
+	 */
+	size_t tileBytes;
+
+	/**
+	 * @brief The data of each tile, or nullptr if the tile is not mapped
+	 */
+	vector<unsigned char*> tilesData;
+
+	/**
+	 * @brief The mapped tiles, sorted from the most to the least recently used
+	 */
+	list<unsigned int> mappedTiles;
+
+	/**
+	 * @brief The position of each mapped tile in the mappedTiles list
+	 */
+	vector<list<unsigned int>::iterator> mappedTilesPositions;
+
+	/**
+	 * @brief The last requested tile
+	 */
+	unsigned int lastTile;
+
+#ifdef TARGET_WIN32
+	/**
+	 * @brief The pixels file handle
+	 */
+	HANDLE fileHandle;
+
+	/**
+	 * @brief The pixels file mapping handle
+	 */
+	HANDLE mappingHandle;
+#else
+	/**
+	 * @brief The pixels file descriptor
+	 */
+	int fileDescriptor;
+#endif
+};
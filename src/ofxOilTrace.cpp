@@ -1,5 +1,8 @@
 #include "ofxOilTrace.h"
 #include "ofxOilBrush.h"
+#include "ofxOilRandom.h"
+#include "ofxOilTrajectoryLibrary.h"
+#include "ofxOilSerialization.h"
 #include "ofMain.h"
 
 float ofxOilTrace::NOISE_FACTOR = 0.007;
@@ -12,27 +15,87 @@ unsigned int ofxOilTrace::TYPICAL_MIX_STARTING_STEP = 5;
 
 float ofxOilTrace::MIX_STRENGTH = 0.012;
 
+float ofxOilTrace::FLOW_STRENGTH = 0.6;
+
 ofxOilTrace::ofxOilTrace(const glm::vec2& startingPosition, unsigned int nSteps, float speed) {
 	// Check that the input makes sense
 	if (nSteps == 0) {
 		throw invalid_argument("The trace should have at least one step.");
 	}
 
+	// Select one of the library shapes and rotate it to a random initial angle
+	float initAng = ofxOilRandom(TWO_PI);
+	unsigned int shapeIndex = floor(ofxOilRandom(ofxOilTrajectoryLibrary::SHAPES_PER_LENGTH));
+	const vector<glm::vec2>& shape = ofxOilTrajectoryLibrary::getShape(nSteps, shapeIndex);
+	float cosAng = speed * cos(initAng);
+	float sinAng = speed * sin(initAng);
+
 	// Fill the positions and alphas containers
-	float initAng = ofRandom(TWO_PI);
-	float noiseSeed = ofRandom(1000);
-	float alphaDecrement = min(255.0 / nSteps, 25.0);
-	positions.push_back(startingPosition);
-	alphas.push_back(255);
+	positions.resize(nSteps);
+
+	for (unsigned int i = 0; i < nSteps; ++i) {
+		const glm::vec2& pos = shape[i];
+		positions[i].x = startingPosition.x + cosAng * pos.x - sinAng * pos.y;
+		positions[i].y = startingPosition.y + sinAng * pos.x + cosAng * pos.y;
+	}
+
+	alphas = ofxOilTrajectoryLibrary::getAlphaRamp(nSteps);
+
+	// Set the average color as totally transparent
+	averageColor.set(0, 0);
+	brightnessNoiseStart = 0;
+	bFirstStep = 0;
+}
+
+ofxOilTrace::ofxOilTrace(const glm::vec2& startingPosition, unsigned int nSteps, float speed,
+		const ofxOilFlowField& flowField) {
+	// Check that the input makes sense
+	if (nSteps == 0) {
+		throw invalid_argument("The trace should have at least one step.");
+	}
+
+	// Select one of the library shapes and start moving in a random direction
+	float initAng = ofxOilRandom(TWO_PI);
+	unsigned int shapeIndex = floor(ofxOilRandom(ofxOilTrajectoryLibrary::SHAPES_PER_LENGTH));
+	const vector<glm::vec2>& shape = ofxOilTrajectoryLibrary::getShape(nSteps, shapeIndex);
+	glm::vec2 direction(cos(initAng), sin(initAng));
+
+	// Fill the positions container, following the shape turns and the flow direction
+	positions.resize(nSteps);
+	positions[0] = startingPosition;
 
 	for (unsigned int i = 1; i < nSteps; ++i) {
-		float ang = initAng + TWO_PI * (ofNoise(noiseSeed + NOISE_FACTOR * i) - 0.5);
-		positions.emplace_back(positions[i - 1].x + speed * cos(ang), positions[i - 1].y + speed * sin(ang));
-		alphas.push_back(255 - alphaDecrement * i);
+		// Apply the shape turn between the previous step and this step
+		glm::vec2 step = shape[i] - shape[i - 1];
+
+		if (i > 1) {
+			glm::vec2 previousStep = shape[i - 1] - shape[i - 2];
+			float cosTurn = previousStep.x * step.x + previousStep.y * step.y;
+			float sinTurn = previousStep.x * step.y - previousStep.y * step.x;
+			direction = glm::vec2(cosTurn * direction.x - sinTurn * direction.y,
+					sinTurn * direction.x + cosTurn * direction.y);
+		}
+
+		// Pull the direction towards the flow, which has no sign
+		glm::vec2 flow = flowField.getFlow(positions[i - 1]);
+
+		if (flow.x * direction.x + flow.y * direction.y < 0) {
+			flow = -flow;
+		}
+
+		direction += FLOW_STRENGTH * flow;
+		direction /= max(glm::length(direction), 1e-6f);
+
+		// Move to the next position
+		positions[i] = positions[i - 1] + speed * glm::length(step) * direction;
 	}
 
+	alphas = ofxOilTrajectoryLibrary::getAlphaRamp(nSteps);
+
 	// Set the average color as totally transparent
 	averageColor.set(0, 0);
+	brightnessNoiseStart = 0;
+	bFirstStep = 0;
 }
 
 ofxOilTrace::ofxOilTrace(const vector<glm::vec2>& _positions, const vector<unsigned char>& _alphas) {
@@ -46,11 +109,14 @@ ofxOilTrace::ofxOilTrace(const vector<glm::vec2>& _positions, const vector<unsig
 	positions = _positions;
 	alphas = _alphas;
 	averageColor.set(0, 0);
+	brightnessNoiseStart = 0;
+	bFirstStep = 0;
 }
 
 void ofxOilTrace::setBrushSize(float brushSize) {
 	// Initialize the brush
 	brush = ofxOilBrush(positions[0], brushSize);
+	brightnessNoiseStart = floor(ofxOilRandom(getBrightnessNoise().size()));
 
 	// Reset the average color
 	averageColor.set(0, 0);
@@ -64,21 +130,29 @@ void ofxOilTrace::setBrushSize(float brushSize) {
 
 void ofxOilTrace::calculateBristlePositions() {
 	// Reset the container
-	bPositions.clear();
+	unsigned int nSteps = getNSteps();
+	unsigned int nBristles = getNBristles();
+	bPositions.resize(nSteps * nBristles);
+	bFirstStep = nSteps;
 
-	for (const glm::vec2& pos : positions) {
+	for (unsigned int i = 0; i < nSteps; ++i) {
 		// Move the brush
-		brush.updatePosition(pos, false);
+		brush.updatePosition(positions[i], false);
+
+		// Save the bristles positions if the brush could already calculate them
+		ofxOilSpan<const glm::vec2> stepPositions = brush.getBristlesPositions();
 
-		// Save the bristles positions
-		bPositions.push_back(brush.getBristlesPositions());
+		if (!stepPositions.empty()) {
+			bFirstStep = min(bFirstStep, i);
+			copy(stepPositions.begin(), stepPositions.end(), bPositions.begin() + i * nBristles);
+		}
 	}
 
 	// Reset the brush to the initial position
 	brush.resetPosition(positions[0]);
 }
 
-void ofxOilTrace::calculateBristleImageColors(const ofImage& img) {
+void ofxOilTrace::calculateBristleImageColors(const ofxOilPixelView& img) {
 	// Extract some useful information
 	int width = img.getWidth();
 	int height = img.getHeight();
@@ -89,22 +163,16 @@ void ofxOilTrace::calculateBristleImageColors(const ofImage& img) {
 	}
 
 	// Calculate the image colors at the bristles positions
-	bImgColors.clear();
+	bImgColors.assign(bPositions.size(), ofColor(0, 0));
 
-	for (const vector<glm::vec2>& bp : bPositions) {
-		bImgColors.emplace_back();
-		vector<ofColor>& bic = bImgColors.back();
+	for (unsigned int index = bFirstStep * getNBristles(), nPositions = bPositions.size(); index < nPositions;
+			++index) {
+		// Check that the bristle is inside the image
+		int x = bPositions[index].x;
+		int y = bPositions[index].y;
 
-		for (const glm::vec2& pos : bp) {
-			// Check that the bristle is inside the image
-			int x = pos.x;
-			int y = pos.y;
-
-			if (x >= 0 && x < width && y >= 0 && y < height) {
-				bic.push_back(img.getColor(x, y));
-			} else {
-				bic.emplace_back(0, 0);
-			}
+		if (x >= 0 && x < width && y >= 0 && y < height) {
+			bImgColors[index] = img.getColor(x, y);
 		}
 	}
 }
@@ -120,27 +188,124 @@ void ofxOilTrace::calculateBristlePaintedColors(const ofPixels& paintedPixels, c
 	}
 
 	// Calculate the painted colors at the bristles positions
-	bPaintedColors.clear();
+	bPaintedColors.assign(bPositions.size(), ofColor(0, 0));
+
+	for (unsigned int index = bFirstStep * getNBristles(), nPositions = bPositions.size(); index < nPositions;
+			++index) {
+		// Check that the bristle is inside the canvas
+		int x = bPositions[index].x;
+		int y = bPositions[index].y;
 
-	for (const vector<glm::vec2>& bp : bPositions) {
-		bPaintedColors.emplace_back();
-		vector<ofColor>& bpc = bPaintedColors.back();
+		if (x >= 0 && x < width && y >= 0 && y < height) {
+			const ofColor& color = paintedPixels.getColor(x, y);
 
-		for (const glm::vec2& pos : bp) {
-			// Check that the bristle is inside the canvas
+			if (color != backgroundColor && color.a != 0) {
+				bPaintedColors[index] = color;
+			}
+		}
+	}
+}
+
+void ofxOilTrace::gatherBristleColors(const ofxOilPixelView& img, const ofPixels& paintedPixels,
+		const ofColor& backgroundColor) {
+	// Extract some useful information
+	unsigned int nSteps = getNSteps();
+	unsigned int nBristles = getNBristles();
+	int imgWidth = img.getWidth();
+	int imgHeight = img.getHeight();
+	int paintedWidth = paintedPixels.getWidth();
+	int paintedHeight = paintedPixels.getHeight();
+	unsigned int paintedNumChannels = paintedPixels.getNumChannels();
+	const unsigned char* paintedData = paintedPixels.getData();
+
+	// Reset the containers
+	bPositions.resize(nSteps * nBristles);
+	bImgColors.assign(nSteps * nBristles, ofColor(0, 0));
+	bPaintedColors.assign(nSteps * nBristles, ofColor(0, 0));
+	bFirstStep = nSteps;
+
+	for (unsigned int i = 0; i < nSteps; ++i) {
+		// Move the brush
+		brush.updatePosition(positions[i], false);
+
+		// Check that the brush could already calculate the bristles positions
+		ofxOilSpan<const glm::vec2> stepPositions = brush.getBristlesPositions();
+
+		if (stepPositions.empty()) {
+			continue;
+		}
+
+		bFirstStep = min(bFirstStep, i);
+
+		// Save the bristles positions and the colors below them
+		for (unsigned int bristle = 0, index = i * nBristles; bristle < nBristles; ++bristle, ++index) {
+			const glm::vec2& pos = stepPositions[bristle];
+			bPositions[index] = pos;
 			int x = pos.x;
 			int y = pos.y;
 
-			if (x >= 0 && x < width && y >= 0 && y < height) {
-				const ofColor& color = paintedPixels.getColor(x, y);
+			if (x >= 0 && x < imgWidth && y >= 0 && y < imgHeight) {
+				bImgColors[index] = img.getColor(x, y);
+			}
+
+			if (x >= 0 && x < paintedWidth && y >= 0 && y < paintedHeight) {
+				const unsigned char* pixel = paintedData + (y * paintedWidth + x) * paintedNumChannels;
+				ofColor color(pixel[0], pixel[1], pixel[2], paintedNumChannels == 4 ? pixel[3] : 255);
 
 				if (color != backgroundColor && color.a != 0) {
-					bpc.push_back(color);
-				} else {
-					bpc.emplace_back(0, 0);
+					bPaintedColors[index] = color;
 				}
-			} else {
-				bpc.emplace_back(0, 0);
+			}
+		}
+	}
+
+	// Reset the brush to the initial position
+	brush.resetPosition(positions[0]);
+}
+
+void ofxOilTrace::gatherBristleColors(const ofxOilPixelView& img, ofxOilTiledPixels& paintedPixels,
+		const ofColor& backgroundColor) {
+	// Calculate the bristle positions and the image colors below them
+	bPositions.clear();
+	calculateBristleImageColors(img);
+
+	// Map the painted pixels tiles that are covered by the bristles
+	float xMin = numeric_limits<float>::max();
+	float xMax = numeric_limits<float>::lowest();
+	float yMin = numeric_limits<float>::max();
+	float yMax = numeric_limits<float>::lowest();
+
+	for (unsigned int index = bFirstStep * getNBristles(), nPositions = bPositions.size(); index < nPositions;
+			++index) {
+		const glm::vec2& pos = bPositions[index];
+		xMin = min(xMin, pos.x);
+		xMax = max(xMax, pos.x);
+		yMin = min(yMin, pos.y);
+		yMax = max(yMax, pos.y);
+	}
+
+	if (xMin <= xMax) {
+		paintedPixels.mapRegion(ofRectangle(xMin, yMin, xMax - xMin, yMax - yMin));
+	}
+
+	// Calculate the painted colors at the bristles positions
+	int width = paintedPixels.getWidth();
+	int height = paintedPixels.getHeight();
+	unsigned int nChannels = paintedPixels.getNumChannels();
+	bPaintedColors.assign(bPositions.size(), ofColor(0, 0));
+
+	for (unsigned int index = bFirstStep * getNBristles(), nPositions = bPositions.size(); index < nPositions;
+			++index) {
+		// Check that the bristle is inside the canvas
+		int x = bPositions[index].x;
+		int y = bPositions[index].y;
+
+		if (x >= 0 && x < width && y >= 0 && y < height) {
+			const unsigned char* pixel = paintedPixels.getPixel(x, y);
+			ofColor color(pixel[0], pixel[1], pixel[2], nChannels == 4 ? pixel[3] : 255);
+
+			if (color != backgroundColor && color.a != 0) {
+				bPaintedColors[index] = color;
 			}
 		}
 	}
@@ -154,6 +319,10 @@ void ofxOilTrace::setAverageColor(const ofColor& color) {
 }
 
 void ofxOilTrace::calculateAverageColor(const ofImage& img) {
+	calculateAverageColor(ofxOilPixelView(img.getPixels()));
+}
+
+void ofxOilTrace::calculateAverageColor(const ofxOilPixelView& img) {
 	// Calculate the bristle image colors if necessary
 	if (bImgColors.size() == 0) {
 		calculateBristleImageColors(img);
@@ -165,10 +334,10 @@ void ofxOilTrace::calculateAverageColor(const ofImage& img) {
 	float blueSum = 0;
 	int counter = 0;
 
-	for (unsigned int i = 0, nSteps = getNSteps(); i < nSteps; ++i) {
+	for (unsigned int i = bFirstStep, nSteps = getNSteps(); i < nSteps; ++i) {
 		// Check that the alpha value is high enough for the average color calculation
 		if (alphas[i] >= MIN_ALPHA) {
-			for (const ofColor& color : bImgColors[i]) {
+			for (const ofColor& color : getBristleImageColors(i)) {
 				if (color.a != 0) {
 					redSum += color.r;
 					greenSum += color.g;
@@ -196,65 +365,90 @@ void ofxOilTrace::calculateBristleColors(const ofPixels& paintedPixels, const of
 		calculateBristlePaintedColors(paintedPixels, backgroundColor);
 	}
 
-	// Calculate the starting colors for each bristle
-	vector<ofColor> startingColors = vector<ofColor>(nBristles);
-	float noiseSeed = ofRandom(1000);
+	// The bristle colors only differ in brightness, which scales linearly the average color RGB values at maximum
+	// brightness
 	float averageHue, averageSaturation, averageBrightness;
 	averageColor.getHsb(averageHue, averageSaturation, averageBrightness);
+	ofFloatColor maxBrightnessColor = ofFloatColor::fromHsb(averageHue / ofColor::limit(),
+			averageSaturation / ofColor::limit(), 1);
+
+	// Calculate the starting colors for each bristle, adding some brightness changes to make it more realistic
+	const vector<float>& brightnessNoise = getBrightnessNoise();
+	vector<ofColor> startingColors = vector<ofColor>(nBristles);
 
 	for (unsigned int bristle = 0; bristle < nBristles; ++bristle) {
-		// Add some brightness changes to make it more realistic
-		float deltaBrightness = BRIGHTNESS_RELATIVE_CHANGE * averageBrightness
-				* (ofNoise(noiseSeed + 0.4 * bristle) - 0.5);
-		startingColors[bristle].setHsb(averageHue, averageSaturation, averageBrightness + deltaBrightness);
+		float noise = brightnessNoise[(brightnessNoiseStart + bristle) % brightnessNoise.size()];
+		float brightness = ofClamp(averageBrightness * (1 + BRIGHTNESS_RELATIVE_CHANGE * noise), 0,
+				ofColor::limit());
+		startingColors[bristle].set(brightness * maxBrightnessColor.r, brightness * maxBrightnessColor.g,
+				brightness * maxBrightnessColor.b);
 	}
 
 	// Use the bristle starting colors until the step where the mixing starts
 	unsigned int mixStartingStep = ofClamp(TYPICAL_MIX_STARTING_STEP, 1, nSteps);
-	bColors = vector<vector<ofColor>>(mixStartingStep, startingColors);
+	bColors.resize(nSteps * nBristles);
+
+	for (unsigned int i = 0; i < mixStartingStep; ++i) {
+		copy(startingColors.begin(), startingColors.end(), bColors.begin() + i * nBristles);
+	}
 
-	// Mix the previous step colors with the already painted colors
-	vector<float> redPrevious;
-	vector<float> greenPrevious;
-	vector<float> bluePrevious;
+	// Mix the previous step colors with the already painted colors using 16 bits fixed point arithmetic
+	vector<int32_t> redPrevious(nBristles);
+	vector<int32_t> greenPrevious(nBristles);
+	vector<int32_t> bluePrevious(nBristles);
 
-	for (const ofColor& color : startingColors) {
-		redPrevious.push_back(color.r);
-		greenPrevious.push_back(color.g);
-		bluePrevious.push_back(color.b);
+	for (unsigned int bristle = 0; bristle < nBristles; ++bristle) {
+		redPrevious[bristle] = int32_t(startingColors[bristle].r) << 16;
+		greenPrevious[bristle] = int32_t(startingColors[bristle].g) << 16;
+		bluePrevious[bristle] = int32_t(startingColors[bristle].b) << 16;
 	}
 
-	float f = 1 - MIX_STRENGTH;
+	int64_t mixStrength = round(MIX_STRENGTH * 65536);
 
 	for (unsigned int i = mixStartingStep; i < nSteps; ++i) {
 		// Copy the previous step colors
-		bColors.push_back(bColors.back());
+		ofColor* bc = bColors.data() + i * nBristles;
+		copy(bc - nBristles, bc, bc);
 
 		// Check that the alpha value is high enough for mixing
-		if (alphas[i] >= MIN_ALPHA) {
-			// Calculate the bristle colors for this step
-			vector<ofColor>& bc = bColors.back();
-			const vector<ofColor>& bpc = bPaintedColors[i];
-
-			if (bpc.size() > 0) {
-				for (unsigned int bristle = 0; bristle < nBristles; ++bristle) {
-					const ofColor& paintedColor = bpc[bristle];
-
-					if (paintedColor.a != 0) {
-						float redMix = f * redPrevious[bristle] + MIX_STRENGTH * paintedColor.r;
-						float greenMix = f * greenPrevious[bristle] + MIX_STRENGTH * paintedColor.g;
-						float blueMix = f * bluePrevious[bristle] + MIX_STRENGTH * paintedColor.b;
-						redPrevious[bristle] = redMix;
-						greenPrevious[bristle] = greenMix;
-						bluePrevious[bristle] = blueMix;
-						bc[bristle].set(redMix, greenMix, blueMix);
-					}
-				}
-			}
+		if (alphas[i] < MIN_ALPHA || i < bFirstStep) {
+			continue;
+		}
+
+		// Mix all the bristles at once. Bristles that are not over a painted pixel keep their previous color.
+		const ofColor* bpc = bPaintedColors.data() + i * nBristles;
+
+		for (unsigned int bristle = 0; bristle < nBristles; ++bristle) {
+			const ofColor& paintedColor = bpc[bristle];
+			int64_t mix = paintedColor.a != 0 ? mixStrength : 0;
+			int32_t& red = redPrevious[bristle];
+			int32_t& green = greenPrevious[bristle];
+			int32_t& blue = bluePrevious[bristle];
+			red += (mix * ((int32_t(paintedColor.r) << 16) - red)) >> 16;
+			green += (mix * ((int32_t(paintedColor.g) << 16) - green)) >> 16;
+			blue += (mix * ((int32_t(paintedColor.b) << 16) - blue)) >> 16;
+			bc[bristle].r = red >> 16;
+			bc[bristle].g = green >> 16;
+			bc[bristle].b = blue >> 16;
 		}
 	}
 }
 
+const vector<float>& ofxOilTrace::getBrightnessNoise() {
+	// Sample the noise function once with the same spacing used between consecutive bristles
+	static const vector<float> brightnessNoise = []() {
+		vector<float> noise(4096);
+
+		for (unsigned int i = 0; i < noise.size(); ++i) {
+			noise[i] = ofNoise(0.4 * i) - 0.5;
+		}
+
+		return noise;
+	}();
+
+	return brightnessNoise;
+}
+
 void ofxOilTrace::paint() {
 	// Check that the bristle colors have been calculated before running this method
 	if (bColors.size() == 0) {
@@ -266,36 +460,90 @@ void ofxOilTrace::paint() {
 		brush.updatePosition(positions[i], true);
 
 		// Paint the brush
-		brush.paint(bColors[i], alphas[i]);
+		brush.paint(getBristleColors(i), alphas[i]);
 	}
 
 	// Reset the brush to the initial position
 	brush.resetPosition(positions[0]);
 }
 
-void ofxOilTrace::paint(ofFbo& canvasBuffer) {
+void ofxOilTrace::paintRibbons() const {
 	// Check that the bristle colors have been calculated before running this method
 	if (bColors.size() == 0) {
-		throw logic_error("Please, run calculateBristleColors method before paint.");
+		throw logic_error("Please, run calculateBristleColors method before paintRibbons.");
 	}
 
-	for (unsigned int i = 0, nSteps = getNSteps(); i < nSteps; ++i) {
-		// Move the brush
-		brush.updatePosition(positions[i], true);
+	// The brush is only painted once it has enough positions to calculate its direction
+	unsigned int nSteps = getNSteps();
+	unsigned int nBristles = getNBristles();
+	unsigned int firstStep = max(max(ofxOilBrush::POSITIONS_FOR_AVERAGE, 1u) - 1, bFirstStep);
 
-		// Paint the brush
-		brush.paint(bColors[i], alphas[i]);
+	if (firstStep + 1 >= nSteps || nBristles == 0) {
+		return;
+	}
 
-		// Paint the trace on the canvas only if alpha is high enough
-		if (alphas[i] >= MIN_ALPHA) {
-			canvasBuffer.begin();
-			brush.paint(bColors[i], 255);
-			canvasBuffer.end();
+	// Calculate the alpha values after the bristles pass several times over the same pixels
+	float halfThickness = 0.5 * brush.getBristlesThickness();
+	float stepLength = max(glm::distance(positions[0], positions[1]), 0.01f);
+	float nOverlaps = max(1.0f, (brush.getBristlesLength() + 2 * halfThickness) / stepLength);
+	vector<float> ribbonAlphas(nSteps);
+
+	for (unsigned int i = 0; i < nSteps; ++i) {
+		ribbonAlphas[i] = 1 - pow(1 - alphas[i] / 255.0f, nOverlaps);
+	}
+
+	// Build the ribbons mesh
+	ofMesh mesh;
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+
+	for (unsigned int bristle = 0; bristle < nBristles; ++bristle) {
+		glm::vec3 previousLeft, previousRight;
+		ofFloatColor previousColor;
+
+		for (unsigned int i = firstStep; i < nSteps; ++i) {
+			// Calculate the ribbon borders perpendicular to the bristle direction
+			const glm::vec2& pos = bPositions[i * nBristles + bristle];
+			const glm::vec2& nextPos = bPositions[min(i + 1, nSteps - 1) * nBristles + bristle];
+			const glm::vec2& previousPos = bPositions[(max(i, firstStep + 1) - 1) * nBristles + bristle];
+			glm::vec2 direction = nextPos - previousPos;
+			float length = glm::length(direction);
+			glm::vec2 offset =
+					length > 0 ? (halfThickness / length) * glm::vec2(-direction.y, direction.x) : glm::vec2();
+			glm::vec3 left(pos.x + offset.x, pos.y + offset.y, 0);
+			glm::vec3 right(pos.x - offset.x, pos.y - offset.y, 0);
+
+			// Get the bristle color at this step
+			const ofColor& color = bColors[i * nBristles + bristle];
+			ofFloatColor vertexColor(color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, ribbonAlphas[i]);
+
+			// Connect the vertices with the previous step vertices. Each segment has its own vertices, with a texture
+			// coordinate that indicates if the step alpha is high enough to paint it on the canvas buffer.
+			if (i > firstStep) {
+				glm::vec2 bufferFlag(1, alphas[i] >= MIN_ALPHA ? 1 : 0);
+				unsigned int index = mesh.getNumVertices();
+				mesh.addVertex(previousLeft);
+				mesh.addColor(previousColor);
+				mesh.addTexCoord(bufferFlag);
+				mesh.addVertex(previousRight);
+				mesh.addColor(previousColor);
+				mesh.addTexCoord(bufferFlag);
+				mesh.addVertex(left);
+				mesh.addColor(vertexColor);
+				mesh.addTexCoord(bufferFlag);
+				mesh.addVertex(right);
+				mesh.addColor(vertexColor);
+				mesh.addTexCoord(bufferFlag);
+				mesh.addTriangle(index, index + 1, index + 2);
+				mesh.addTriangle(index + 1, index + 3, index + 2);
+			}
+
+			previousLeft = left;
+			previousRight = right;
+			previousColor = vertexColor;
 		}
 	}
 
-	// Reset the brush to the initial position
-	brush.resetPosition(positions[0]);
+	mesh.draw();
 }
 
 void ofxOilTrace::paintStep(unsigned int step) {
@@ -310,7 +558,7 @@ void ofxOilTrace::paintStep(unsigned int step) {
 		brush.updatePosition(positions[step], true);
 
 		// Paint the brush
-		brush.paint(bColors[step], alphas[step]);
+		brush.paint(getBristleColors(step), alphas[step]);
 
 		// Reset the brush to the initial position if we are at the last trajectory step
 		if (step == getNSteps() - 1) {
@@ -319,7 +567,13 @@ void ofxOilTrace::paintStep(unsigned int step) {
 	}
 }
 
-void ofxOilTrace::paintStep(unsigned int step, ofFbo& canvasBuffer) {
+void ofxOilTrace::paint(ofPixels& canvasPixels, ofPixels* canvasBufferPixels) {
+	for (unsigned int i = 0, nSteps = getNSteps(); i < nSteps; ++i) {
+		paintStep(i, canvasPixels, canvasBufferPixels);
+	}
+}
+
+void ofxOilTrace::paintStep(unsigned int step, ofPixels& canvasPixels, ofPixels* canvasBufferPixels) {
 	// Check that the bristle colors have been calculated before running this method
 	if (bColors.size() == 0) {
 		throw logic_error("Please, run calculateBristleColors method before paint.");
@@ -331,13 +585,11 @@ void ofxOilTrace::paintStep(unsigned int step, ofFbo& canvasBuffer) {
 		brush.updatePosition(positions[step], true);
 
 		// Paint the brush
-		brush.paint(bColors[step], alphas[step]);
+		brush.paint(canvasPixels, getBristleColors(step), alphas[step]);
 
-		// Paint the trace on the canvas only if alpha is high enough
-		if (alphas[step] >= MIN_ALPHA) {
-			canvasBuffer.begin();
-			brush.paint(bColors[step], 255);
-			canvasBuffer.end();
+		// Paint the trace on the canvas buffer only if alpha is high enough
+		if (canvasBufferPixels != nullptr && alphas[step] >= MIN_ALPHA) {
+			brush.paint(*canvasBufferPixels, getBristleColors(step), 255);
 		}
 
 		// Reset the brush to the initial position if we are at the last trajectory step
@@ -367,18 +619,77 @@ unsigned int ofxOilTrace::getNBristles() const {
 	return brush.getNBristles();
 }
 
-const vector<vector<glm::vec2>>& ofxOilTrace::getBristlePositions() const {
+unsigned int ofxOilTrace::getFirstBristleStep() const {
+	return bFirstStep;
+}
+
+const vector<glm::vec2>& ofxOilTrace::getBristlePositions() const {
 	return bPositions;
 }
 
-const vector<vector<ofColor>>& ofxOilTrace::getBristleImageColors() const {
+ofxOilSpan<const glm::vec2> ofxOilTrace::getBristlePositions(unsigned int step) const {
+	return getStepSpan(bPositions, step, bFirstStep);
+}
+
+const vector<ofColor>& ofxOilTrace::getBristleImageColors() const {
 	return bImgColors;
 }
 
-const vector<vector<ofColor>>& ofxOilTrace::getBristlePaintedColors() const {
+ofxOilSpan<const ofColor> ofxOilTrace::getBristleImageColors(unsigned int step) const {
+	return getStepSpan(bImgColors, step, bFirstStep);
+}
+
+const vector<ofColor>& ofxOilTrace::getBristlePaintedColors() const {
 	return bPaintedColors;
 }
 
-const vector<vector<ofColor>>& ofxOilTrace::getBristleColors() const {
+ofxOilSpan<const ofColor> ofxOilTrace::getBristlePaintedColors(unsigned int step) const {
+	return getStepSpan(bPaintedColors, step, bFirstStep);
+}
+
+const vector<ofColor>& ofxOilTrace::getBristleColors() const {
 	return bColors;
 }
+
+ofxOilSpan<const ofColor> ofxOilTrace::getBristleColors(unsigned int step) const {
+	return getStepSpan(bColors, step, 0);
+}
+
+template<typename T>
+ofxOilSpan<const T> ofxOilTrace::getStepSpan(const vector<T>& values, unsigned int step,
+		unsigned int firstStep) const {
+	// Check that the step has valid data
+	unsigned int nBristles = getNBristles();
+
+	if (step < firstStep || (step + 1) * nBristles > values.size()) {
+		return ofxOilSpan<const T>();
+	}
+
+	return ofxOilSpan<const T>(values.data() + step * nBristles, nBristles);
+}
+
+void ofxOilTrace::save(ostream& out) const {
+	ofxOilWrite(out, positions);
+	ofxOilWrite(out, alphas);
+	ofxOilWrite(out, averageColor);
+	brush.save(out);
+	ofxOilWrite(out, bFirstStep);
+	ofxOilWrite(out, bPositions);
+	ofxOilWrite(out, bImgColors);
+	ofxOilWrite(out, bPaintedColors);
+	ofxOilWrite(out, bColors);
+	ofxOilWrite(out, brightnessNoiseStart);
+}
+
+void ofxOilTrace::load(istream& in) {
+	ofxOilRead(in, positions);
+	ofxOilRead(in, alphas);
+	ofxOilRead(in, averageColor);
+	brush.load(in);
+	ofxOilRead(in, bFirstStep);
+	ofxOilRead(in, bPositions);
+	ofxOilRead(in, bImgColors);
+	ofxOilRead(in, bPaintedColors);
+	ofxOilRead(in, bColors);
+	ofxOilRead(in, brightnessNoiseStart);
+}
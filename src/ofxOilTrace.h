@@ -2,6 +2,9 @@
 
 #include "ofMain.h"
 #include "ofxOilBrush.h"
+#include "ofxOilPixelView.h"
+#include "ofxOilFlowField.h"
+#include "ofxOilTiledPixels.h"
 
 /**
  * @brief Class that simulates the movement of a brush on the canvas
@@ -13,6 +16,9 @@ public:
 
 	/**
 	 * @brief Sets how random the trace movement is
+	 *
+	 * It should be set before the first trace is created, since the trajectory shapes are cached in the
+	 * ofxOilTrajectoryLibrary.
 	 */
 	static float NOISE_FACTOR;
 
@@ -36,6 +42,11 @@ public:
 	 */
 	static float MIX_STRENGTH;
 
+	/**
+	 * @brief How strongly the flow field steers the trace trajectories
+	 */
+	static float FLOW_STRENGTH;
+
 	/**
 	 * @brief Constructor
 	 *
@@ -45,6 +56,21 @@ public:
 	 */
 	ofxOilTrace(const glm::vec2& startingPosition = glm::vec2(), unsigned int nSteps = 20, float speed = 2);
 
+	/**
+	 * @brief Constructor
+	 *
+	 * The trajectory follows the curvature of a library shape, but at each step its direction is pulled towards the
+	 * flow field direction, weighted by the flow coherence. Traces started in coherent regions will then move along
+	 * the image edges instead of crossing them.
+	 *
+	 * @param startingPosition the trace starting position
+	 * @param nSteps the total number of steps in the trace trajectory
+	 * @param speed the trace moving speed (pixels/step)
+	 * @param flowField the flow field that steers the trajectory
+	 */
+	ofxOilTrace(const glm::vec2& startingPosition, unsigned int nSteps, float speed,
+			const ofxOilFlowField& flowField);
+
 	/**
 	 * @brief Constructor
 	 *
@@ -56,6 +82,9 @@ public:
 	/**
 	 * @brief Sets the trace brush size
 	 *
+	 * All the random values needed to paint the trace are drawn here, so the remaining calculations can be run
+	 * from any thread.
+	 *
 	 * @param brushSize the brush size
 	 */
 	void setBrushSize(float brushSize);
@@ -74,6 +103,37 @@ public:
 	 */
 	void calculateAverageColor(const ofImage& img);
 
+	/**
+	 * @brief Calculates the trace average color along the painted image
+	 *
+	 * @param img the view of the painted image pixels
+	 */
+	void calculateAverageColor(const ofxOilPixelView& img);
+
+	/**
+	 * @brief Calculates the bristle positions and samples the image and painted colors at them in a single pass
+	 *
+	 * The calculateAverageColor and calculateBristleColors methods will then reuse the sampled colors.
+	 *
+	 * @param img the view of the painted image pixels
+	 * @param paintedPixels the painted pixels
+	 * @param backgroundColor the canvas background color
+	 */
+	void gatherBristleColors(const ofxOilPixelView& img, const ofPixels& paintedPixels,
+			const ofColor& backgroundColor);
+
+	/**
+	 * @brief Calculates the bristle positions and samples the image and painted colors at them
+	 *
+	 * The painted pixels tiles around the trace are mapped into memory before the painted colors are sampled.
+	 *
+	 * @param img the view of the painted image pixels
+	 * @param paintedPixels the painted pixels, stored in a tiled container
+	 * @param backgroundColor the canvas background color
+	 */
+	void gatherBristleColors(const ofxOilPixelView& img, ofxOilTiledPixels& paintedPixels,
+			const ofColor& backgroundColor);
+
 	/**
 	 * @brief Calculates the trace bristle colors
 	 *
@@ -90,14 +150,19 @@ public:
 	void paint();
 
 	/**
-	 * @brief Paints the trace
+	 * @brief Paints the trace as one ribbon per bristle in a single draw call
 	 *
-	 * Note that the calculateBristleColors method should have been run before.
+	 * Each ribbon follows the bristle path along the whole trajectory, with the bristle colors at each step. The
+	 * alpha values are increased to account for the repeated painting of the same pixels by the paint method, so
+	 * the result stays close to it at a fraction of the rendering cost.
+	 *
+	 * The boosted alphas cannot be used to decide which parts of the ribbons should be painted on the canvas buffer.
+	 * The second texture coordinate of each vertex is set to 1 instead when the original step alpha is at least
+	 * MIN_ALPHA, and to 0 otherwise.
 	 *
-	 * @param canvasBuffer the canvas buffer where the trace should also be painted when the color exceeds a minimum
-	 * alpha value
+	 * Note that the calculateBristleColors method should have been run before.
 	 */
-	void paint(ofFbo& canvasBuffer);
+	void paintRibbons() const;
 
 	/**
 	 * @brief Paints a given step in the trace trajectory
@@ -109,15 +174,27 @@ public:
 	void paintStep(unsigned int step);
 
 	/**
-	 * @brief Paints a given step in the trace trajectory
+	 * @brief Paints the trace on the CPU
+	 *
+	 * Note that the calculateBristleColors method should have been run before.
+	 *
+	 * @param canvasPixels the canvas pixels where the trace should be painted
+	 * @param canvasBufferPixels the canvas buffer pixels where the trace should also be painted when the color
+	 * exceeds a minimum alpha value. It can be nullptr.
+	 */
+	void paint(ofPixels& canvasPixels, ofPixels* canvasBufferPixels);
+
+	/**
+	 * @brief Paints a given step in the trace trajectory on the CPU
 	 *
 	 * Note that the calculateBristleColors method should have been run before.
 	 *
 	 * @param step the trace trajectory step to paint
-	 * @param canvasBuffer the canvas buffer where the trace should also be painted when the color exceeds a minimum
-	 * alpha value
+	 * @param canvasPixels the canvas pixels where the trace should be painted
+	 * @param canvasBufferPixels the canvas buffer pixels where the trace should also be painted when the color
+	 * exceeds a minimum alpha value. It can be nullptr.
 	 */
-	void paintStep(unsigned int step, ofFbo& canvasBuffer);
+	void paintStep(unsigned int step, ofPixels& canvasPixels, ofPixels* canvasBufferPixels);
 
 	/**
 	 * @brief Returns the number of steps in the trace trajectory
@@ -154,33 +231,101 @@ public:
 	 */
 	unsigned int getNBristles() const;
 
+	/**
+	 * @brief Returns the first trajectory step with bristle positions
+	 *
+	 * The brush needs a few positions to calculate its direction, so the bristle data of the previous steps should
+	 * be ignored.
+	 *
+	 * @return the first trajectory step with bristle positions
+	 */
+	unsigned int getFirstBristleStep() const;
+
 	/**
 	 * @brief Returns the brush bristle positions along the trace trajectory
 	 *
+	 * The positions are stored step after step, so the position of a bristle in a given step is at the index
+	 * step * nBristles + bristle.
+	 *
 	 * @return the brush bristle positions along the trace trajectory
 	 */
-	const vector<vector<glm::vec2>>& getBristlePositions() const;
+	const vector<glm::vec2>& getBristlePositions() const;
+
+	/**
+	 * @brief Returns the brush bristle positions at a given trajectory step
+	 *
+	 * @param step the trajectory step
+	 * @return the brush bristle positions at the given step. It will be empty if they are not defined or have not
+	 * been calculated yet.
+	 */
+	ofxOilSpan<const glm::vec2> getBristlePositions(unsigned int step) const;
 
 	/**
 	 * @brief Returns the brush bristle image colors along the trace trajectory
 	 *
+	 * The colors are stored with the same layout as the bristle positions.
+	 *
 	 * @return the brush bristle image colors along the trace trajectory
 	 */
-	const vector<vector<ofColor>>& getBristleImageColors() const;
+	const vector<ofColor>& getBristleImageColors() const;
+
+	/**
+	 * @brief Returns the brush bristle image colors at a given trajectory step
+	 *
+	 * @param step the trajectory step
+	 * @return the brush bristle image colors at the given step. It will be empty if they are not defined or have not
+	 * been calculated yet.
+	 */
+	ofxOilSpan<const ofColor> getBristleImageColors(unsigned int step) const;
 
 	/**
 	 * @brief Returns the brush bristle painted colors along the trace trajectory
 	 *
+	 * The colors are stored with the same layout as the bristle positions.
+	 *
 	 * @return the brush bristle painted colors along the trace trajectory
 	 */
-	const vector<vector<ofColor>>& getBristlePaintedColors() const;
+	const vector<ofColor>& getBristlePaintedColors() const;
+
+	/**
+	 * @brief Returns the brush bristle painted colors at a given trajectory step
+	 *
+	 * @param step the trajectory step
+	 * @return the brush bristle painted colors at the given step. It will be empty if they are not defined or have
+	 * not been calculated yet.
+	 */
+	ofxOilSpan<const ofColor> getBristlePaintedColors(unsigned int step) const;
 
 	/**
 	 * @brief Returns the brush bristle colors along the trace trajectory
 	 *
+	 * The colors are stored with the same layout as the bristle positions.
+	 *
 	 * @return the brush bristle colors along the trace trajectory
 	 */
-	const vector<vector<ofColor>>& getBristleColors() const;
+	const vector<ofColor>& getBristleColors() const;
+
+	/**
+	 * @brief Returns the brush bristle colors at a given trajectory step
+	 *
+	 * @param step the trajectory step
+	 * @return the brush bristle colors at the given step. It will be empty if they have not been calculated yet.
+	 */
+	ofxOilSpan<const ofColor> getBristleColors(unsigned int step) const;
+
+	/**
+	 * @brief Saves the trace state in a binary stream
+	 *
+	 * @param out the output stream
+	 */
+	void save(ostream& out) const;
+
+	/**
+	 * @brief Loads the trace state from a binary stream
+	 *
+	 * @param in the input stream
+	 */
+	void load(istream& in);
 
 protected:
 
@@ -192,9 +337,9 @@ protected:
 	/**
 	 * @brief Calculates the image colors at the bristles positions
 	 *
-	 * @param img the painted image
+	 * @param img the view of the painted image pixels
 	 */
-	void calculateBristleImageColors(const ofImage& img);
+	void calculateBristleImageColors(const ofxOilPixelView& img);
 
 	/**
 	 * @brief Calculates the painted colors at the bristles positions
@@ -204,6 +349,24 @@ protected:
 	 */
 	void calculateBristlePaintedColors(const ofPixels& paintedPixels, const ofColor& backgroundColor);
 
+	/**
+	 * @brief Returns a precomputed table with the noise values used to vary the bristles brightness
+	 *
+	 * @return the brightness noise values, in the range [-0.5, 0.5]
+	 */
+	static const vector<float>& getBrightnessNoise();
+
+	/**
+	 * @brief Returns the part of a bristle data array that corresponds to a given trajectory step
+	 *
+	 * @param values the bristle data array, stored step after step
+	 * @param step the trajectory step
+	 * @param firstStep the first step with valid data
+	 * @return the bristle data at the given step, or an empty span if the step has no valid data
+	 */
+	template<typename T>
+	ofxOilSpan<const T> getStepSpan(const vector<T>& values, unsigned int step, unsigned int firstStep) const;
+
 	/**
 	 * @brief The trace trajectory positions
 	 */
@@ -225,22 +388,32 @@ protected:
 	ofxOilBrush brush;
 
 	/**
-	 * @brief The trace bristle positions along the trajectory
+	 * @brief The first trajectory step with bristle positions
+	 */
+	unsigned int bFirstStep;
+
+	/**
+	 * @brief The trace bristle positions along the trajectory, stored step after step
+	 */
+	vector<glm::vec2> bPositions;
+
+	/**
+	 * @brief The trace bristle image colors along the trajectory, stored step after step
 	 */
-	vector<vector<glm::vec2>> bPositions;
+	vector<ofColor> bImgColors;
 
 	/**
-	 * @brief The trace bristle image colors along the trajectory
+	 * @brief The trace bristle painted colors along the trajectory, stored step after step
 	 */
-	vector<vector<ofColor>> bImgColors;
+	vector<ofColor> bPaintedColors;
 
 	/**
-	 * @brief The trace bristle painted colors along the trajectory
+	 * @brief The trace bristle colors along the trajectory, stored step after step
 	 */
-	vector<vector<ofColor>> bPaintedColors;
+	vector<ofColor> bColors;
 
 	/**
-	 * @brief The trace bristle colors along the trajectory
+	 * @brief The brightness noise table position used for the first bristle
 	 */
-	vector<vector<ofColor>> bColors;
+	unsigned int brightnessNoiseStart;
 };
@@ -0,0 +1,75 @@
+#include "ofxOilTrajectoryLibrary.h"
+#include "ofxOilTrace.h"
+#include "ofMain.h"
+
+unsigned int ofxOilTrajectoryLibrary::SHAPES_PER_LENGTH = 256;
+
+mutex ofxOilTrajectoryLibrary::libraryMutex;
+
+array<vector<vector<glm::vec2>>, 32> ofxOilTrajectoryLibrary::shapes;
+
+array<atomic<bool>, 32> ofxOilTrajectoryLibrary::filledBuckets;
+
+const vector<glm::vec2>& ofxOilTrajectoryLibrary::getShape(unsigned int nSteps, unsigned int shapeIndex) {
+	// Check that the input makes sense
+	if (shapeIndex >= SHAPES_PER_LENGTH) {
+		throw invalid_argument("The shape index should be smaller than SHAPES_PER_LENGTH.");
+	} else if (nSteps > (1u << 31)) {
+		throw invalid_argument("The number of steps is too large.");
+	}
+
+	// Find the length bucket that contains the shape
+	unsigned int bucketIndex = 0;
+
+	while ((1u << bucketIndex) < nSteps) {
+		++bucketIndex;
+	}
+
+	// Fill the bucket if it's the first time that it's used. The lock is only taken until the bucket is filled.
+	if (!filledBuckets[bucketIndex].load(memory_order_acquire)) {
+		lock_guard<mutex> lock(libraryMutex);
+
+		if (!filledBuckets[bucketIndex].load(memory_order_relaxed)) {
+			unsigned int bucketLength = 1u << bucketIndex;
+			vector<vector<glm::vec2>>& bucket = shapes[bucketIndex];
+			bucket.reserve(SHAPES_PER_LENGTH);
+
+			for (unsigned int i = 0; i < SHAPES_PER_LENGTH; ++i) {
+				bucket.push_back(calculateShape(bucketLength, 1000.0 * i / SHAPES_PER_LENGTH));
+			}
+
+			filledBuckets[bucketIndex].store(true, memory_order_release);
+		}
+	}
+
+	// The bucket could have been filled with a different SHAPES_PER_LENGTH value
+	const vector<vector<glm::vec2>>& bucket = shapes[bucketIndex];
+
+	if (shapeIndex >= bucket.size()) {
+		throw out_of_range("The shape index is outside the length bucket.");
+	}
+
+	return bucket[shapeIndex];
+}
+
+vector<unsigned char> ofxOilTrajectoryLibrary::getAlphaRamp(unsigned int nSteps) {
+	vector<unsigned char> alphas(nSteps);
+	float alphaDecrement = min(255.0 / nSteps, 25.0);
+
+	for (unsigned int i = 0; i < nSteps; ++i) {
+		alphas[i] = 255 - alphaDecrement * i;
+	}
+
+	return alphas;
+}
+
+vector<glm::vec2> ofxOilTrajectoryLibrary::calculateShape(unsigned int nSteps, float noiseSeed) {
+	vector<glm::vec2> positions(nSteps);
+
+	for (unsigned int i = 1; i < nSteps; ++i) {
+		float ang = TWO_PI * (ofNoise(noiseSeed + ofxOilTrace::NOISE_FACTOR * i) - 0.5);
+		positions[i] = positions[i - 1] + glm::vec2(cos(ang), sin(ang));
+	}
+
+	return positions;
+}
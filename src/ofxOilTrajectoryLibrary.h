@@ -0,0 +1,74 @@
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+
+/**
+ * @brief Class that stores precomputed trace trajectory shapes and alpha ramps
+ *
+ * The shapes are normalized to a unit speed and a zero initial angle, and start at the origin. They are generated
+ * from a fixed set of noise seeds and grouped in length buckets of power of two sizes, so a trace with any number of
+ * steps can use the first steps of the bucket shapes. Traces are then obtained by rotation and translation of a
+ * library shape.
+ *
+ * The library is filled lazily and it can be used from several threads at the same time.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilTrajectoryLibrary {
+public:
+
+	/**
+	 * @brief The number of different shapes in each length bucket
+	 *
+	 * It should be set before the first trace is created.
+	 */
+	static unsigned int SHAPES_PER_LENGTH;
+
+	/**
+	 * @brief Returns a normalized trajectory shape
+	 *
+	 * @param nSteps the minimum number of steps in the shape
+	 * @param shapeIndex the shape index in the range [0, SHAPES_PER_LENGTH)
+	 * @return the shape positions for a unit speed and a zero initial angle. It can have more than nSteps positions.
+	 * The reference remains valid until the program ends.
+	 */
+	static const vector<glm::vec2>& getShape(unsigned int nSteps, unsigned int shapeIndex);
+
+	/**
+	 * @brief Returns the trace alpha values for a given number of steps
+	 *
+	 * The ramps are not cached, since calculating them costs the same as copying them.
+	 *
+	 * @param nSteps the number of trace steps
+	 * @return the trace alpha values at each trajectory step
+	 */
+	static vector<unsigned char> getAlphaRamp(unsigned int nSteps);
+
+protected:
+
+	/**
+	 * @brief Calculates a normalized trajectory shape
+	 *
+	 * @param nSteps the number of steps in the shape
+	 * @param noiseSeed the noise seed that defines the shape
+	 * @return the shape positions
+	 */
+	static vector<glm::vec2> calculateShape(unsigned int nSteps, float noiseSeed);
+
+	/**
+	 * @brief The mutex that serializes the filling of the length buckets
+	 */
+	static mutex libraryMutex;
+
+	/**
+	 * @brief The trajectory shapes for each length bucket, indexed by the base 2 logarithm of the bucket length
+	 */
+	static array<vector<vector<glm::vec2>>, 32> shapes;
+
+	/**
+	 * @brief Indicates if each length bucket has been filled. Filled buckets are never modified, so they can be read
+	 * without locking the mutex.
+	 */
+	static array<atomic<bool>, 32> filledBuckets;
+};
@@ -0,0 +1,386 @@
+#include "ofxOilVideoPipeline.h"
+#include "ofxOilSimulator.h"
+#include "ofxOilRandom.h"
+#include "ofMain.h"
+
+ofxOilVideoPipeline::ofxOilVideoPipeline(const FrameDecoder& _frameDecoder, const FrameWriter& _frameWriter,
+		unsigned int _width, unsigned int _height, unsigned int queueCapacity) :
+		frameDecoder(_frameDecoder), frameWriter(_frameWriter), width(_width), height(_height), stopPipeline(false) {
+	// Check that the input makes sense
+	if (!frameDecoder || !frameWriter) {
+		throw invalid_argument("The frame decoder and the frame writer should be valid functions.");
+	} else if (width == 0 || height == 0) {
+		throw invalid_argument("The painted frames dimensions should be higher than zero.");
+	}
+
+	targetPsnr = 0;
+	maxTraces = 0;
+	maxSeconds = 0;
+	capacity = queueCapacity;
+	framesPerChunk = 1;
+	firstSeed = 0;
+	reorderWindow = 0;
+	nWrittenFrames = 0;
+
+	for (ofxOilBoundedQueue<Frame>& queue : queues) {
+		queue.setCapacity(queueCapacity);
+	}
+
+	for (StageCounters& stageCounters : counters) {
+		stageCounters.nFrames = 0;
+		stageCounters.busyTime = 0;
+		stageCounters.inputWaitTime = 0;
+		stageCounters.outputWaitTime = 0;
+		stageCounters.nActiveThreads = 0;
+	}
+}
+
+ofxOilVideoPipeline::~ofxOilVideoPipeline() {
+	stop();
+
+	for (thread& t : threads) {
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+}
+
+void ofxOilVideoPipeline::setPaintingLimits(float _targetPsnr, unsigned int _maxTraces, float _maxSeconds) {
+	targetPsnr = _targetPsnr;
+	maxTraces = _maxTraces;
+	maxSeconds = _maxSeconds;
+}
+
+void ofxOilVideoPipeline::start(unsigned int nResizeThreads, unsigned int nPaintThreads, unsigned int seed,
+		unsigned int _framesPerChunk) {
+	// Check that the input makes sense
+	if (threads.size() > 0) {
+		throw logic_error("Please, run the wait method before starting the pipeline again.");
+	} else if (_framesPerChunk == 0) {
+		throw invalid_argument("The number of frames per chunk should be higher than zero.");
+	}
+
+	// Reset the queues and the counters
+	stopPipeline = false;
+	pipelineException = nullptr;
+	startTime = chrono::steady_clock::now();
+	framesPerChunk = _framesPerChunk;
+	firstSeed = seed;
+
+	for (ofxOilBoundedQueue<Frame>& queue : queues) {
+		queue.reset();
+	}
+
+	nResizeThreads = max(nResizeThreads, 1u);
+	nPaintThreads = nPaintThreads > 0 ? nPaintThreads : max(thread::hardware_concurrency(), 1u);
+	paintQueues.clear();
+
+	for (unsigned int i = 0; i < nPaintThreads; ++i) {
+		paintQueues.emplace_back(new ofxOilBoundedQueue<Frame>(capacity));
+	}
+
+	reorderWindow = nPaintThreads * framesPerChunk + capacity;
+	nWrittenFrames = 0;
+	array<unsigned int, 4> nThreads = { 1, nResizeThreads, nPaintThreads, 1 };
+
+	for (unsigned int i = 0; i < counters.size(); ++i) {
+		counters[i].nFrames = 0;
+		counters[i].busyTime = 0;
+		counters[i].inputWaitTime = 0;
+		counters[i].outputWaitTime = 0;
+		counters[i].nActiveThreads = nThreads[i];
+	}
+
+	// Start the stage threads
+	threads.emplace_back(&ofxOilVideoPipeline::runDecodeStage, this);
+
+	for (unsigned int i = 0; i < nResizeThreads; ++i) {
+		threads.emplace_back(&ofxOilVideoPipeline::runResizeStage, this);
+	}
+
+	for (unsigned int i = 0; i < nPaintThreads; ++i) {
+		threads.emplace_back(&ofxOilVideoPipeline::runPaintStage, this, i);
+	}
+
+	threads.emplace_back(&ofxOilVideoPipeline::runWriteStage, this);
+}
+
+void ofxOilVideoPipeline::wait() {
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	threads.clear();
+
+	if (pipelineException) {
+		rethrow_exception(pipelineException);
+	}
+}
+
+void ofxOilVideoPipeline::stop() {
+	stopPipeline = true;
+
+	// Wake up the resize threads waiting for the reorder window
+	{
+		lock_guard<mutex> lock(windowMutex);
+	}
+
+	windowChanged.notify_all();
+
+	for (ofxOilBoundedQueue<Frame>& queue : queues) {
+		queue.close();
+	}
+
+	for (unique_ptr<ofxOilBoundedQueue<Frame>>& queue : paintQueues) {
+		queue->close();
+	}
+}
+
+bool ofxOilVideoPipeline::isFinished() const {
+	for (const StageCounters& stageCounters : counters) {
+		if (stageCounters.nActiveThreads > 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ofxOilVideoPipeline::StageStats ofxOilVideoPipeline::getStageStats(Stage stage) const {
+	const StageCounters& stageCounters = counters[static_cast<unsigned int>(stage)];
+	StageStats stats;
+	stats.nFrames = stageCounters.nFrames;
+	stats.busySeconds = stageCounters.busyTime * 1e-6;
+	stats.inputWaitSeconds = stageCounters.inputWaitTime * 1e-6;
+	stats.outputWaitSeconds = stageCounters.outputWaitTime * 1e-6;
+	stats.framesPerSecond = stats.nFrames / max(getTime() * 1e-6, 1e-6);
+	return stats;
+}
+
+void ofxOilVideoPipeline::runDecodeStage() {
+	StageCounters& stageCounters = counters[static_cast<unsigned int>(Stage::DECODE)];
+	ofxOilBoundedQueue<Frame>& output = queues[0];
+
+	try {
+		for (unsigned int index = 0; !stopPipeline; ++index) {
+			// Decode the next frame
+			uint64_t time = getTime();
+			Frame frame;
+			frame.index = index;
+
+			if (!frameDecoder(frame.pixels)) {
+				break;
+			}
+
+			uint64_t decodeTime = getTime();
+			stageCounters.busyTime += decodeTime - time;
+			++stageCounters.nFrames;
+
+			// Pass the frame to the next stage, waiting if its queue is full
+			if (!output.push(move(frame))) {
+				break;
+			}
+
+			stageCounters.outputWaitTime += getTime() - decodeTime;
+		}
+	} catch (...) {
+		handleException();
+	}
+
+	--stageCounters.nActiveThreads;
+	output.close();
+}
+
+void ofxOilVideoPipeline::runResizeStage() {
+	StageCounters& stageCounters = counters[static_cast<unsigned int>(Stage::RESIZE)];
+	ofxOilBoundedQueue<Frame>& input = queues[0];
+
+	try {
+		Frame frame;
+		uint64_t time = getTime();
+
+		while (!stopPipeline) {
+			// Wait for the next frame
+			if (!input.pop(frame)) {
+				break;
+			}
+
+			uint64_t popTime = getTime();
+			stageCounters.inputWaitTime += popTime - time;
+
+			// Resize the frame if necessary
+			if (frame.pixels.getWidth() != width || frame.pixels.getHeight() != height) {
+				frame.pixels.resize(width, height);
+			}
+
+			uint64_t processTime = getTime();
+			stageCounters.busyTime += processTime - popTime;
+			++stageCounters.nFrames;
+
+			// Wait until the frame fits in the reorder window, so the frames waiting to be painted or written in
+			// order don't accumulate without limit
+			{
+				unique_lock<mutex> lock(windowMutex);
+				windowChanged.wait(lock, [this, &frame]() {
+					return stopPipeline || frame.index < nWrittenFrames + reorderWindow;
+				});
+			}
+
+			if (stopPipeline) {
+				break;
+			}
+
+			// Pass the frame to the paint thread that paints its chunk, waiting if its queue is full
+			unsigned int paintThread = (frame.index / framesPerChunk) % paintQueues.size();
+
+			if (!paintQueues[paintThread]->push(move(frame))) {
+				break;
+			}
+
+			time = getTime();
+			stageCounters.outputWaitTime += time - processTime;
+		}
+	} catch (...) {
+		handleException();
+	}
+
+	// Close the paint queues when the last resize thread finishes
+	if (--stageCounters.nActiveThreads == 0) {
+		for (unique_ptr<ofxOilBoundedQueue<Frame>>& queue : paintQueues) {
+			queue->close();
+		}
+	}
+}
+
+void ofxOilVideoPipeline::runPaintStage(unsigned int paintThread) {
+	StageCounters& stageCounters = counters[static_cast<unsigned int>(Stage::PAINT)];
+	ofxOilBoundedQueue<Frame>& input = *paintQueues[paintThread];
+	ofxOilBoundedQueue<Frame>& output = queues[1];
+
+	try {
+		// Each thread paints its chunks with its own simulator. The resize threads can pass the frames out of order,
+		// so they are kept in a pending list until the next frame to paint arrives. The simulator paints through a
+		// view of the current frame, so the frame is kept until the next one replaces it.
+		ofxOilSimulator simulator(false, false, false, true);
+		map<unsigned int, Frame> pendingFrames;
+		Frame currentFrame;
+		unsigned int nextIndex = paintThread * framesPerChunk;
+		bool outputIsClosed = false;
+		Frame frame;
+		uint64_t time = getTime();
+
+		while (!stopPipeline && !outputIsClosed && input.pop(frame)) {
+			uint64_t popTime = getTime();
+			stageCounters.inputWaitTime += popTime - time;
+			unsigned int index = frame.index;
+			pendingFrames[index] = move(frame);
+
+			// Paint all the frames that are ready in order
+			for (auto next = pendingFrames.begin(); next != pendingFrames.end() && next->first == nextIndex;
+					next = pendingFrames.erase(next)) {
+				// Start each chunk with a clean canvas and a seed that depends on the chunk number
+				uint64_t paintStartTime = getTime();
+				bool clearCanvas = nextIndex % framesPerChunk == 0;
+
+				if (clearCanvas) {
+					ofxOilSeedRandom(firstSeed + nextIndex / framesPerChunk);
+				}
+
+				currentFrame = move(next->second);
+				simulator.setImagePixels(ofxOilPixelView(currentFrame.pixels), clearCanvas);
+				simulator.paintUntil(targetPsnr, maxTraces, maxSeconds);
+				Frame paintedFrame;
+				paintedFrame.index = currentFrame.index;
+				simulator.getCanvasPixels(paintedFrame.pixels);
+				uint64_t paintEndTime = getTime();
+				stageCounters.busyTime += paintEndTime - paintStartTime;
+				++stageCounters.nFrames;
+
+				// Move to the next frame, jumping over the chunks painted by the other threads
+				++nextIndex;
+
+				if (nextIndex % framesPerChunk == 0) {
+					nextIndex += (paintQueues.size() - 1) * framesPerChunk;
+				}
+
+				// Pass the frame to the next stage, waiting if its queue is full
+				if (!output.push(move(paintedFrame))) {
+					outputIsClosed = true;
+					break;
+				}
+
+				stageCounters.outputWaitTime += getTime() - paintEndTime;
+			}
+
+			time = getTime();
+		}
+	} catch (...) {
+		handleException();
+	}
+
+	// Close the output queue when the last paint thread finishes
+	if (--stageCounters.nActiveThreads == 0) {
+		output.close();
+	}
+}
+
+void ofxOilVideoPipeline::runWriteStage() {
+	StageCounters& stageCounters = counters[static_cast<unsigned int>(Stage::WRITE)];
+	ofxOilBoundedQueue<Frame>& input = queues[1];
+
+	try {
+		// The frames can arrive out of order when there are several paint threads
+		map<unsigned int, ofPixels> pendingFrames;
+		unsigned int nextIndex = 0;
+		Frame frame;
+		uint64_t time = getTime();
+
+		while (!stopPipeline && input.pop(frame)) {
+			uint64_t popTime = getTime();
+			stageCounters.inputWaitTime += popTime - time;
+			pendingFrames[frame.index] = move(frame.pixels);
+
+			// Write all the frames that are ready in order
+			for (auto next = pendingFrames.begin(); next != pendingFrames.end() && next->first == nextIndex;
+					next = pendingFrames.erase(next), ++nextIndex) {
+				if (!frameWriter(next->first, next->second)) {
+					throw runtime_error("Could not write the painted frame " + ofToString(next->first));
+				}
+
+				++stageCounters.nFrames;
+
+				// Move the reorder window
+				{
+					lock_guard<mutex> lock(windowMutex);
+					nWrittenFrames = next->first + 1;
+				}
+
+				windowChanged.notify_all();
+			}
+
+			time = getTime();
+			stageCounters.busyTime += time - popTime;
+		}
+	} catch (...) {
+		handleException();
+	}
+
+	--stageCounters.nActiveThreads;
+}
+
+void ofxOilVideoPipeline::handleException() {
+	// Keep the first exception and stop the pipeline
+	{
+		lock_guard<mutex> lock(exceptionMutex);
+
+		if (!pipelineException) {
+			pipelineException = current_exception();
+		}
+	}
+
+	stop();
+}
+
+uint64_t ofxOilVideoPipeline::getTime() const {
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startTime).count();
+}
@@ -0,0 +1,356 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOilBoundedQueue.h"
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+/**
+ * @brief Class that paints a stream of video frames with a multi-stage pipeline
+ *
+ * The frames go through four stages: decode, resize, paint and write. Each stage runs on its own threads and the
+ * stages are connected with bounded queues, so a slow stage makes the previous stages wait instead of accumulating
+ * frames. The decode and write stages use one thread each, and the write stage outputs the frames in their original
+ * order. The paint threads use simulators with a CPU canvas. The frames are split in chunks of consecutive frames,
+ * and all the frames of a chunk are painted in order by the same paint thread, each one starting from the previous
+ * painting. Every chunk starts with a clean canvas and a random seed that depends on the chunk number, so the
+ * painting doesn't depend on the number of threads or their scheduling, unless a painting time limit is used.
+ *
+ * The paint and write stages reorder the frames, so the resize stage waits before passing a frame that is more than
+ * nPaintThreads * framesPerChunk + queueCapacity frames ahead of the next frame to write. The window is large enough
+ * to let all the paint threads work on their chunks at the same time, and it bounds the number of frames that the
+ * paint and write stages keep until their turn comes.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilVideoPipeline {
+public:
+
+	/**
+	 * @brief The pipeline stages
+	 */
+	enum class Stage {
+		/**
+		 * @brief The stage that decodes the video frames
+		 */
+		DECODE,
+
+		/**
+		 * @brief The stage that resizes the decoded frames
+		 */
+		RESIZE,
+
+		/**
+		 * @brief The stage that paints the resized frames
+		 */
+		PAINT,
+
+		/**
+		 * @brief The stage that writes the painted frames
+		 */
+		WRITE
+	};
+
+	/**
+	 * @brief Structure with the performance counters of a pipeline stage
+	 */
+	struct StageStats {
+		/**
+		 * @brief The number of frames processed by the stage
+		 */
+		unsigned int nFrames;
+
+		/**
+		 * @brief The time spent processing frames, summed over the stage threads, in seconds
+		 */
+		double busySeconds;
+
+		/**
+		 * @brief The time spent waiting for frames from the previous stage, summed over the stage threads, in seconds
+		 */
+		double inputWaitSeconds;
+
+		/**
+		 * @brief The time spent waiting for space in the next stage queue, summed over the stage threads, in seconds
+		 */
+		double outputWaitSeconds;
+
+		/**
+		 * @brief The number of processed frames per second since the pipeline started
+		 */
+		double framesPerSecond;
+	};
+
+	/**
+	 * @brief The function type used to decode the video frames
+	 *
+	 * It is called sequentially from the decode thread and should return false when there are no more frames.
+	 */
+	typedef function<bool(ofPixels&)> FrameDecoder;
+
+	/**
+	 * @brief The function type used to write the painted frames
+	 *
+	 * It is called sequentially from the write thread with the frame number and the painted frame, in the frames
+	 * order. It should return false if the frame could not be written.
+	 */
+	typedef function<bool(unsigned int, const ofPixels&)> FrameWriter;
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param _frameDecoder the function used to decode the video frames
+	 * @param _frameWriter the function used to write the painted frames
+	 * @param _width the width of the painted frames
+	 * @param _height the height of the painted frames
+	 * @param queueCapacity the maximum number of frames waiting between two stages. It's also the reorder window
+	 * margin.
+	 */
+	ofxOilVideoPipeline(const FrameDecoder& _frameDecoder, const FrameWriter& _frameWriter, unsigned int _width,
+			unsigned int _height, unsigned int queueCapacity = 4);
+
+	/**
+	 * @brief Destructor. Stops the pipeline if it's running.
+	 */
+	~ofxOilVideoPipeline();
+
+	/**
+	 * @brief Sets the limits used to stop the painting of each frame
+	 *
+	 * @param _targetPsnr the target peak signal-to-noise ratio in dB. 0 means no quality limit.
+	 * @param _maxTraces the maximum number of traces to paint per frame. 0 means no traces limit.
+	 * @param _maxSeconds the maximum time to spend per frame in seconds. 0 means no time limit.
+	 */
+	void setPaintingLimits(float _targetPsnr, unsigned int _maxTraces, float _maxSeconds);
+
+	/**
+	 * @brief Starts the pipeline threads
+	 *
+	 * @param nResizeThreads the number of threads in the resize stage
+	 * @param nPaintThreads the number of threads in the paint stage. 0 means one thread per hardware thread.
+	 * @param seed the random number engine seed used by the first chunk. The other chunks use the following seeds.
+	 * @param _framesPerChunk the number of consecutive frames painted by the same paint thread
+	 */
+	void start(unsigned int nResizeThreads = 1, unsigned int nPaintThreads = 0, unsigned int seed = 0,
+			unsigned int _framesPerChunk = 30);
+
+	/**
+	 * @brief Waits until all the frames went through the pipeline
+	 *
+	 * Rethrows the first exception thrown by the pipeline threads, if any.
+	 */
+	void wait();
+
+	/**
+	 * @brief Stops the pipeline as soon as possible, dropping the frames inside it
+	 */
+	void stop();
+
+	/**
+	 * @brief Indicates if all the pipeline threads finished
+	 *
+	 * @return true if all the pipeline threads finished
+	 */
+	bool isFinished() const;
+
+	/**
+	 * @brief Returns the performance counters of a pipeline stage
+	 *
+	 * @param stage the pipeline stage
+	 * @return the stage performance counters
+	 */
+	StageStats getStageStats(Stage stage) const;
+
+protected:
+
+	/**
+	 * @brief Structure that stores a frame and its number
+	 */
+	struct Frame {
+		/**
+		 * @brief The frame number
+		 */
+		unsigned int index;
+
+		/**
+		 * @brief The frame pixels
+		 */
+		ofPixels pixels;
+	};
+
+	/**
+	 * @brief Structure with the thread safe counters of a pipeline stage
+	 */
+	struct StageCounters {
+		/**
+		 * @brief The number of processed frames
+		 */
+		atomic<unsigned int> nFrames;
+
+		/**
+		 * @brief The time spent processing frames in microseconds
+		 */
+		atomic<uint64_t> busyTime;
+
+		/**
+		 * @brief The time spent waiting for input frames in microseconds
+		 */
+		atomic<uint64_t> inputWaitTime;
+
+		/**
+		 * @brief The time spent waiting for space in the output queue in microseconds
+		 */
+		atomic<uint64_t> outputWaitTime;
+
+		/**
+		 * @brief The number of stage threads that are still running
+		 */
+		atomic<unsigned int> nActiveThreads;
+	};
+
+	/**
+	 * @brief Runs the decode stage thread
+	 */
+	void runDecodeStage();
+
+	/**
+	 * @brief Runs a resize stage thread
+	 */
+	void runResizeStage();
+
+	/**
+	 * @brief Runs the write stage thread
+	 */
+	void runWriteStage();
+
+	/**
+	 * @brief Runs a paint stage thread
+	 *
+	 * @param paintThread the paint thread index
+	 */
+	void runPaintStage(unsigned int paintThread);
+
+	/**
+	 * @brief Saves the exception that is being handled and stops the pipeline
+	 */
+	void handleException();
+
+	/**
+	 * @brief Returns the time since the pipeline started
+	 *
+	 * @return the time since the pipeline started in microseconds
+	 */
+	uint64_t getTime() const;
+
+	/**
+	 * @brief The function used to decode the video frames
+	 */
+	FrameDecoder frameDecoder;
+
+	/**
+	 * @brief The function used to write the painted frames
+	 */
+	FrameWriter frameWriter;
+
+	/**
+	 * @brief The width of the painted frames
+	 */
+	unsigned int width;
+
+	/**
+	 * @brief The height of the painted frames
+	 */
+	unsigned int height;
+
+	/**
+	 * @brief The target peak signal-to-noise ratio for each frame
+	 */
+	float targetPsnr;
+
+	/**
+	 * @brief The maximum number of traces to paint per frame
+	 */
+	unsigned int maxTraces;
+
+	/**
+	 * @brief The maximum time to spend per frame
+	 */
+	float maxSeconds;
+
+	/**
+	 * @brief The input queue of the resize stage (0) and the input queue of the write stage (1). Each paint thread
+	 * has its own input queue.
+	 */
+	array<ofxOilBoundedQueue<Frame>, 2> queues;
+
+	/**
+	 * @brief The input queues of each paint thread
+	 */
+	vector<unique_ptr<ofxOilBoundedQueue<Frame>>> paintQueues;
+
+	/**
+	 * @brief The maximum number of frames in each queue
+	 */
+	unsigned int capacity;
+
+	/**
+	 * @brief The number of consecutive frames painted by the same paint thread
+	 */
+	unsigned int framesPerChunk;
+
+	/**
+	 * @brief The random number engine seed used by the first chunk
+	 */
+	unsigned int firstSeed;
+
+	/**
+	 * @brief The maximum distance between a resized frame number and the next frame to write
+	 */
+	unsigned int reorderWindow;
+
+	/**
+	 * @brief The number of frames written in order
+	 */
+	unsigned int nWrittenFrames;
+
+	/**
+	 * @brief The mutex that protects the number of written frames
+	 */
+	mutex windowMutex;
+
+	/**
+	 * @brief The condition variable used to wait until the frame fits in the reorder window
+	 */
+	condition_variable windowChanged;
+
+	/**
+	 * @brief The counters of each stage
+	 */
+	array<StageCounters, 4> counters;
+
+	/**
+	 * @brief The pipeline threads
+	 */
+	vector<thread> threads;
+
+	/**
+	 * @brief Indicates if the pipeline should be stopped
+	 */
+	atomic<bool> stopPipeline;
+
+	/**
+	 * @brief The time when the pipeline started
+	 */
+	chrono::steady_clock::time_point startTime;
+
+	/**
+	 * @brief The mutex that protects the pipeline exception
+	 */
+	mutex exceptionMutex;
+
+	/**
+	 * @brief The first exception thrown by the pipeline threads
+	 */
+	exception_ptr pipelineException;
+};
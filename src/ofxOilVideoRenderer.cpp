@@ -0,0 +1,151 @@
+#include "ofxOilVideoRenderer.h"
+#include "ofxOilSimulator.h"
+#include "ofxOilRandom.h"
+#include "ofMain.h"
+
+ofxOilVideoRenderer::ofxOilVideoRenderer(const FrameLoader& _frameLoader, unsigned int _nFrames,
+		const string& _outputPattern, unsigned int _framesPerChunk, unsigned int _seed, bool _useCanvasBuffer) :
+		frameLoader(_frameLoader), nFrames(_nFrames), outputPattern(_outputPattern), framesPerChunk(_framesPerChunk),
+		seed(_seed), useCanvasBuffer(_useCanvasBuffer), nextChunk(0), nPaintedFrames(0), nSkippedFrames(0),
+		nActiveWorkers(0), stopRendering(false) {
+	// Check that the input makes sense
+	if (!frameLoader) {
+		throw invalid_argument("The frame loader should be a valid function.");
+	} else if (framesPerChunk == 0) {
+		throw invalid_argument("The number of frames per chunk should be higher than zero.");
+	}
+
+	targetPsnr = 0;
+	maxTraces = 0;
+	maxSeconds = 0;
+}
+
+ofxOilVideoRenderer::~ofxOilVideoRenderer() {
+	stop();
+
+	for (thread& worker : workers) {
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+}
+
+void ofxOilVideoRenderer::setPaintingLimits(float _targetPsnr, unsigned int _maxTraces, float _maxSeconds) {
+	targetPsnr = _targetPsnr;
+	maxTraces = _maxTraces;
+	maxSeconds = _maxSeconds;
+}
+
+void ofxOilVideoRenderer::start(unsigned int nThreads) {
+	// Check that the previous rendering is finished
+	if (workers.size() > 0) {
+		throw logic_error("Please, run the wait method before starting a new rendering.");
+	}
+
+	// Reset the counters
+	nextChunk = 0;
+	nPaintedFrames = 0;
+	nSkippedFrames = 0;
+	stopRendering = false;
+	workerException = nullptr;
+
+	// Start the worker threads, but not more than the number of chunks
+	unsigned int nChunks = (nFrames + framesPerChunk - 1) / framesPerChunk;
+
+	if (nThreads == 0) {
+		nThreads = max(thread::hardware_concurrency(), 1u);
+	}
+
+	unsigned int nWorkers = min(nThreads, nChunks);
+	nActiveWorkers = nWorkers;
+
+	for (unsigned int i = 0; i < nWorkers; ++i) {
+		workers.emplace_back(&ofxOilVideoRenderer::paintChunks, this);
+	}
+}
+
+void ofxOilVideoRenderer::wait() {
+	for (thread& worker : workers) {
+		worker.join();
+	}
+
+	workers.clear();
+
+	if (workerException) {
+		rethrow_exception(workerException);
+	}
+}
+
+void ofxOilVideoRenderer::stop() {
+	stopRendering = true;
+}
+
+void ofxOilVideoRenderer::render(unsigned int nThreads) {
+	start(nThreads);
+	wait();
+}
+
+unsigned int ofxOilVideoRenderer::getNPaintedFrames() const {
+	return nPaintedFrames;
+}
+
+unsigned int ofxOilVideoRenderer::getNSkippedFrames() const {
+	return nSkippedFrames;
+}
+
+bool ofxOilVideoRenderer::isFinished() const {
+	return nActiveWorkers == 0;
+}
+
+void ofxOilVideoRenderer::paintChunks() {
+	try {
+		ofPixels framePixels;
+		ofPixels canvasPixels;
+
+		while (!stopRendering) {
+			// Get the next chunk of frames
+			unsigned int chunk = nextChunk++;
+			unsigned int firstFrame = chunk * framesPerChunk;
+
+			if (firstFrame >= nFrames) {
+				break;
+			}
+
+			// Paint the chunk frames with the same simulator, using a deterministic seed
+			ofxOilSeedRandom(seed + chunk);
+			ofxOilSimulator simulator(useCanvasBuffer, false, false, true);
+			bool clearCanvas = true;
+
+			for (unsigned int frame = firstFrame; frame < min(firstFrame + framesPerChunk, nFrames); ++frame) {
+				if (!frameLoader(frame, framePixels)) {
+					++nSkippedFrames;
+					continue;
+				}
+
+				simulator.setImagePixels(ofxOilPixelView(framePixels), clearCanvas);
+				simulator.paintUntil(targetPsnr, maxTraces, maxSeconds);
+				clearCanvas = false;
+
+				// Save the painted frame
+				simulator.getCanvasPixels(canvasPixels);
+
+				if (!ofSaveImage(canvasPixels, ofVAArgsToString(outputPattern.c_str(), frame))) {
+					throw runtime_error("Could not save the painted frame " + ofToString(frame));
+				}
+
+				++nPaintedFrames;
+			}
+		}
+	} catch (...) {
+		// Keep the first exception and stop the other workers
+		lock_guard<mutex> lock(exceptionMutex);
+
+		if (!workerException) {
+			workerException = current_exception();
+		}
+
+		stopRendering = true;
+	}
+
+	--nActiveWorkers;
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief Class that paints the frames of a video offline using several threads
+ *
+ * The video frames are split in chunks of consecutive frames. Each worker thread paints complete chunks with its own
+ * simulator, which uses a CPU canvas. The first frame of a chunk is painted on a clean canvas, and the rest of the
+ * chunk frames start from the previous frame painting. The random number engine is seeded at the start of each
+ * chunk, so the result doesn't depend on the number of threads, unless a painting time limit is used.
+ *
+ * The painted frames are saved as an image sequence, with the frame number in the file names.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilVideoRenderer {
+public:
+
+	/**
+	 * @brief The function type used to load the video frames
+	 *
+	 * It is called from the worker threads with the frame number, and it should return true if the frame was loaded
+	 * in the given pixels container.
+	 */
+	typedef function<bool(unsigned int, ofPixels&)> FrameLoader;
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param _frameLoader the function used to load the video frames. It should be thread safe.
+	 * @param _nFrames the total number of frames to paint
+	 * @param _outputPattern the printf pattern used to create the painted frame file names from the frame number
+	 * @param _framesPerChunk the number of consecutive frames painted by the same simulator
+	 * @param _seed the random number engine seed
+	 * @param _useCanvasBuffer sets if the simulators should use a canvas buffer for the color mixing calculation
+	 */
+	ofxOilVideoRenderer(const FrameLoader& _frameLoader, unsigned int _nFrames, const string& _outputPattern,
+			unsigned int _framesPerChunk = 1, unsigned int _seed = 0, bool _useCanvasBuffer = false);
+
+	/**
+	 * @brief Destructor. Stops the rendering if it's running.
+	 */
+	~ofxOilVideoRenderer();
+
+	/**
+	 * @brief Sets the limits used to stop the painting of each frame
+	 *
+	 * @param _targetPsnr the target peak signal-to-noise ratio in dB. 0 means no quality limit.
+	 * @param _maxTraces the maximum number of traces to paint per frame. 0 means no traces limit.
+	 * @param _maxSeconds the maximum time to spend per frame in seconds. 0 means no time limit.
+	 */
+	void setPaintingLimits(float _targetPsnr, unsigned int _maxTraces, float _maxSeconds);
+
+	/**
+	 * @brief Starts the rendering in the background
+	 *
+	 * @param nThreads the number of worker threads. 0 means one thread per hardware thread.
+	 */
+	void start(unsigned int nThreads = 0);
+
+	/**
+	 * @brief Waits until the rendering is finished
+	 *
+	 * Rethrows the first exception thrown by the worker threads, if any.
+	 */
+	void wait();
+
+	/**
+	 * @brief Stops the rendering after the frames that are being painted are finished
+	 */
+	void stop();
+
+	/**
+	 * @brief Paints all the frames and waits until the rendering is finished
+	 *
+	 * @param nThreads the number of worker threads. 0 means one thread per hardware thread.
+	 */
+	void render(unsigned int nThreads = 0);
+
+	/**
+	 * @brief Returns the number of frames already painted and saved
+	 *
+	 * @return the number of painted frames
+	 */
+	unsigned int getNPaintedFrames() const;
+
+	/**
+	 * @brief Returns the number of frames that could not be loaded
+	 *
+	 * @return the number of skipped frames
+	 */
+	unsigned int getNSkippedFrames() const;
+
+	/**
+	 * @brief Indicates if the worker threads finished, because all the frames were processed, the rendering was
+	 * stopped or an exception was thrown
+	 *
+	 * @return true if the worker threads finished
+	 */
+	bool isFinished() const;
+
+protected:
+
+	/**
+	 * @brief The worker threads loop
+	 */
+	void paintChunks();
+
+	/**
+	 * @brief The function used to load the video frames
+	 */
+	FrameLoader frameLoader;
+
+	/**
+	 * @brief The total number of frames to paint
+	 */
+	unsigned int nFrames;
+
+	/**
+	 * @brief The printf pattern used to create the painted frame file names
+	 */
+	string outputPattern;
+
+	/**
+	 * @brief The number of consecutive frames painted by the same simulator
+	 */
+	unsigned int framesPerChunk;
+
+	/**
+	 * @brief The random number engine seed
+	 */
+	unsigned int seed;
+
+	/**
+	 * @brief Sets if the simulators should use a canvas buffer for the color mixing calculation
+	 */
+	bool useCanvasBuffer;
+
+	/**
+	 * @brief The target peak signal-to-noise ratio for each frame
+	 */
+	float targetPsnr;
+
+	/**
+	 * @brief The maximum number of traces to paint per frame
+	 */
+	unsigned int maxTraces;
+
+	/**
+	 * @brief The maximum time to spend per frame
+	 */
+	float maxSeconds;
+
+	/**
+	 * @brief The worker threads
+	 */
+	vector<thread> workers;
+
+	/**
+	 * @brief The next chunk to paint
+	 */
+	atomic<unsigned int> nextChunk;
+
+	/**
+	 * @brief The number of painted frames
+	 */
+	atomic<unsigned int> nPaintedFrames;
+
+	/**
+	 * @brief The number of frames that could not be loaded
+	 */
+	atomic<unsigned int> nSkippedFrames;
+
+	/**
+	 * @brief The number of worker threads that are still running
+	 */
+	atomic<unsigned int> nActiveWorkers;
+
+	/**
+	 * @brief Indicates if the rendering should be stopped
+	 */
+	atomic<bool> stopRendering;
+
+	/**
+	 * @brief The mutex that protects the worker exception
+	 */
+	mutex exceptionMutex;
+
+	/**
+	 * @brief The first exception thrown by the worker threads
+	 */
+	exception_ptr workerException;
+};
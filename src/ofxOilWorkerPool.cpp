@@ -0,0 +1,61 @@
+#include "ofxOilWorkerPool.h"
+#include "ofMain.h"
+
+static thread_local bool workerThread = false;
+
+ofxOilWorkerPool::ofxOilWorkerPool(unsigned int nThreads) {
+	// Start the worker threads
+	nThreads = nThreads > 0 ? nThreads : max(thread::hardware_concurrency(), 1u);
+	tasks.setCapacity(4 * nThreads);
+
+	for (unsigned int i = 0; i < nThreads; ++i) {
+		workers.emplace_back(&ofxOilWorkerPool::runTasks, this);
+	}
+}
+
+ofxOilWorkerPool::~ofxOilWorkerPool() {
+	// The workers finish the queued tasks before they stop
+	tasks.close();
+
+	for (thread& worker : workers) {
+		worker.join();
+	}
+}
+
+future<void> ofxOilWorkerPool::submit(function<void()> task) {
+	// Check that the input makes sense
+	if (!task) {
+		throw invalid_argument("The task should be a valid function.");
+	}
+
+	packaged_task<void()> packagedTask(move(task));
+	future<void> result = packagedTask.get_future();
+
+	if (!tasks.push(move(packagedTask))) {
+		throw logic_error("The worker pool is stopping and cannot accept new tasks.");
+	}
+
+	return result;
+}
+
+unsigned int ofxOilWorkerPool::getNThreads() const {
+	return workers.size();
+}
+
+bool ofxOilWorkerPool::isWorkerThread() {
+	return workerThread;
+}
+
+ofxOilWorkerPool& ofxOilWorkerPool::getShared() {
+	static ofxOilWorkerPool sharedPool;
+	return sharedPool;
+}
+
+void ofxOilWorkerPool::runTasks() {
+	workerThread = true;
+	packaged_task<void()> task;
+
+	while (tasks.pop(task)) {
+		task();
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOilBoundedQueue.h"
+#include <future>
+#include <thread>
+
+/**
+ * @brief Class that runs tasks on a fixed number of persistent worker threads
+ *
+ * The tasks are run in submission order by the first free worker. A task running in a worker should not wait for
+ * other tasks of the same pool, since all the workers could end up waiting.
+ *
+ * @author Javier Graciá Carpio
+ */
+class ofxOilWorkerPool {
+public:
+
+	/**
+	 * @brief Constructor
+	 *
+	 * @param nThreads the number of worker threads. 0 means one thread per hardware thread.
+	 */
+	ofxOilWorkerPool(unsigned int nThreads = 0);
+
+	/**
+	 * @brief Destructor. Runs the queued tasks and stops the worker threads.
+	 */
+	~ofxOilWorkerPool();
+
+	ofxOilWorkerPool(const ofxOilWorkerPool&) = delete;
+
+	ofxOilWorkerPool& operator=(const ofxOilWorkerPool&) = delete;
+
+	/**
+	 * @brief Adds a task to the pool, waiting if too many tasks are already queued
+	 *
+	 * @param task the task to run
+	 * @return the future that becomes ready when the task finishes, and that rethrows its exceptions
+	 */
+	future<void> submit(function<void()> task);
+
+	/**
+	 * @brief Returns the number of worker threads
+	 *
+	 * @return the number of worker threads
+	 */
+	unsigned int getNThreads() const;
+
+	/**
+	 * @brief Indicates if the current thread is a worker thread of any pool
+	 *
+	 * @return true if the current thread is a worker thread
+	 */
+	static bool isWorkerThread();
+
+	/**
+	 * @brief Returns the pool shared by the addon classes
+	 *
+	 * The pool has one thread per hardware thread and it's created the first time it is used.
+	 *
+	 * @return the shared pool
+	 */
+	static ofxOilWorkerPool& getShared();
+
+protected:
+
+	/**
+	 * @brief The worker threads loop
+	 */
+	void runTasks();
+
+	/**
+	 * @brief The queued tasks
+	 */
+	ofxOilBoundedQueue<packaged_task<void()>> tasks;
+
+	/**
+	 * @brief The worker threads
+	 */
+	vector<thread> workers;
+};